@@ -0,0 +1,139 @@
+// Checks and times AudioRatePattern, Eugene's audio rate mode kernel in src/AudioRatePattern.hpp.
+//
+// The kernel is compared sample by sample with a straightforward model that
+// branches on everything, over random clocks, syncs, lengths, hits, shifts,
+// reverse and invert. Then it's timed the way audio rate mode is worst hit: a
+// clock at Nyquist with length, hits and shift changing every sample. The
+// audio rate mode aims to stay under 50 ns per sample.
+//
+// Usage: make bench
+//    or: c++ -std=c++11 -O2 -march=nehalem -Isrc scripts/bench_audio_rate.cpp src/Rhythm.cpp -o build/bench_audio_rate
+//        build/bench_audio_rate
+
+#include "AudioRatePattern.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace rhythm;
+
+// The same behaviour written the obvious way
+struct Model
+{
+        uint32_t m_step = 0;
+        uint32_t m_played = 0;
+        bool m_high = false;
+
+        void process(float clock, bool sync, uint32_t length, uint32_t hits, uint32_t shift, bool reverse,
+                     bool invert, bool *beat, bool *eoc)
+        {
+                bool high = m_high ? clock > 0.f : clock >= 1.f;
+                bool edge = high && !m_high;
+                m_high = high;
+
+                if(sync || m_step >= length)
+                {
+                        m_step = 0;
+                }
+
+                if(edge)
+                {
+                        if(reverse)
+                        {
+                                m_step = (m_step + length - 1) % length;
+                                m_played = m_step;
+                        }
+                        else
+                        {
+                                m_played = m_step;
+                                m_step = (m_step + 1) % length;
+                        }
+                }
+                if(m_played >= length)
+                {
+                        m_played = 0;
+                }
+
+                Rhythm pattern = rotate(nearEvenRhythm(length, hits, 0), length, shift);
+                *beat = high && pattern[m_played] != invert;
+                *eoc = high && m_played == (reverse ? 0 : length - 1);
+        }
+};
+
+// xorshift32, so every run uses the same signals
+static uint32_t next(uint32_t &state)
+{
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+}
+
+int main(void)
+{
+        const int checked = 2000000;
+        AudioRatePattern kernel;
+        Model model;
+        uint32_t state = 0x2545f491;
+        uint32_t length = 16, hits = 5, shift = 0;
+        bool reverse = false, invert = false;
+        unsigned long long mismatches = 0;
+        for(int i = 0; i < checked; ++i)
+        {
+                // Hold the settings for a while so whole cycles play, then change them
+                uint32_t r = next(state);
+                if(r % 64 == 0)
+                {
+                        length = 1 + next(state) % max_length;
+                        hits = next(state) % (length + 1);
+                        shift = next(state) % length;
+                        reverse = next(state) & 1;
+                        invert = next(state) & 1;
+                }
+
+                // Clocks around the thresholds, with an occasional sync
+                float clock = (float)(r >> 8 & 0xff) / 255.f * 2.f - 0.25f;
+                bool sync = (r >> 16 & 0xff) == 0;
+
+                bool kernel_beat, kernel_eoc, model_beat, model_eoc;
+                kernel.process(clock, sync, length, hits, shift, reverse, invert, &kernel_beat, &kernel_eoc);
+                model.process(clock, sync, length, hits, shift, reverse, invert, &model_beat, &model_eoc);
+                if((kernel_beat != model_beat || kernel_eoc != model_eoc) && mismatches++ < 20)
+                {
+                        printf("Sample %d differs: length %u hits %u shift %u reverse %d invert %d, "
+                               "beat %d eoc %d expected %d %d\n",
+                               i, length, hits, shift, reverse, invert, kernel_beat, kernel_eoc, model_beat,
+                               model_eoc);
+                }
+        }
+        printf("%d samples, %llu mismatches\n", checked, mismatches);
+
+        // Nyquist clock, the knobs following a sine so length, hits and shift change every sample
+        const int timed = 48000 * 10;
+        std::vector<float> clock(timed), cv(timed);
+        for(int i = 0; i < timed; ++i)
+        {
+                clock[i] = i % 2 ? 10.f : 0.f;
+                cv[i] = std::sin(i * 0.01f);
+        }
+
+        AudioRatePattern pattern;
+        unsigned int gates = 0;
+        auto begin = std::chrono::steady_clock::now();
+        for(int i = 0; i < timed; ++i)
+        {
+                uint32_t l = 1 + (uint32_t)((cv[i] + 1.f) * 15.5f + 0.5f);
+                uint32_t h = std::min(l, (uint32_t)(l * (cv[i] + 1.f) * 0.25f + 0.5f));
+                bool beat, eoc;
+                pattern.process(clock[i], false, l, h, (uint32_t)(i >> 8) % l, false, false, &beat, &eoc);
+                gates += beat + eoc;
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count() /
+                    timed;
+        printf("Nyquist clock, settings changing every sample: %.2f ns per sample (%u gates)\n", ns, gates);
+
+        return mismatches ? 1 : 0;
+}
@@ -0,0 +1,176 @@
+// Checks and times rhythm::findNearest() in src/Rhythm.cpp.
+//
+// For every length the AVX2 and scalar search kernels are run over the same
+// patterns and compared with each other and with a brute force search of every
+// density, variation and shift. Short lengths try every pattern, longer ones a
+// fixed pseudo random sample. Then both kernels are timed over the 900 rhythms
+// of length 32, the largest table.
+//
+// Build with the flags the plugin uses (-march=nehalem in the Rack SDK), the
+// AVX2 kernel is chosen at run time and only checked where the CPU has it.
+//
+// Usage: make bench
+//    or: c++ -std=c++11 -O2 -march=nehalem -Isrc scripts/bench_rhythm.cpp src/Rhythm.cpp -o build/bench_rhythm
+//        build/bench_rhythm
+
+#include "Rhythm.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+using namespace rhythm;
+
+// Patterns of up to this length are all tried, longer ones are sampled
+static const uint32_t exhaustive_length = 12;
+static const uint32_t samples = 300;
+
+struct Candidate
+{
+        uint32_t density, variation, shift, distance;
+};
+
+// Every near even rhythm in table order, each at its nearest shift, ties going to the smallest shift then the
+// earliest rhythm as findNearest() breaks them
+static uint32_t bruteForce(uint32_t length, uint32_t pattern, bool rotate, Match *matches, uint32_t k)
+{
+        std::vector<Candidate> candidates;
+        for(uint32_t density = 0; density <= length; ++density)
+        {
+                for(uint32_t variation = 0; variation < numNearEvenRhythms(length, density); ++variation)
+                {
+                        uint32_t base = word(nearEvenRhythm(length, density, variation), length);
+                        Candidate best = {density, variation, 0, UINT32_MAX};
+                        for(uint32_t shift = 0; shift < (rotate ? length : 1); ++shift)
+                        {
+                                uint32_t distance = __builtin_popcount(rotateWord(base, length, shift) ^ pattern);
+                                if(distance < best.distance)
+                                {
+                                        best.shift = shift;
+                                        best.distance = distance;
+                                }
+                        }
+                        candidates.push_back(best);
+                }
+        }
+
+        std::stable_sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b) {
+                return a.distance != b.distance ? a.distance < b.distance : a.shift < b.shift;
+        });
+
+        uint32_t found = std::min<uint32_t>({k, (uint32_t)candidates.size(), 32});
+        for(uint32_t i = 0; i < found; ++i)
+        {
+                matches[i] = {candidates[i].density, candidates[i].variation, candidates[i].shift,
+                              candidates[i].distance};
+        }
+        return found;
+}
+
+static bool same(const Match *a, uint32_t a_found, const Match *b, uint32_t b_found)
+{
+        if(a_found != b_found)
+        {
+                return false;
+        }
+        for(uint32_t i = 0; i < a_found; ++i)
+        {
+                if(a[i].density != b[i].density || a[i].variation != b[i].variation || a[i].shift != b[i].shift ||
+                   a[i].distance != b[i].distance)
+                {
+                        return false;
+                }
+        }
+        return true;
+}
+
+// xorshift32, so every run samples the same patterns
+static uint32_t next(uint32_t &state)
+{
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+}
+
+static double timeSearch(bool rotate, bool vector, uint32_t *checksum)
+{
+        const uint32_t length = max_length;
+        const int passes = rotate ? 2000 : 20000;
+        Match matches[8];
+        uint32_t state = 0x9e3779b9;
+
+        useVectorSearch(vector);
+        auto begin = std::chrono::steady_clock::now();
+        for(int pass = 0; pass < passes; ++pass)
+        {
+                uint32_t found = findNearest(length, next(state), rotate, matches, 8);
+                *checksum += found + matches[0].density + matches[found - 1].distance;
+        }
+        double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count() /
+                    passes;
+        useVectorSearch(true);
+        return us;
+}
+
+int main(void)
+{
+        const uint32_t ks[] = {0, 1, 8, 32};
+#if defined(__x86_64__) || defined(__i386__)
+        bool avx2 = __builtin_cpu_supports("avx2");
+#else
+        bool avx2 = false;
+#endif
+        unsigned long long searches = 0, mismatches = 0;
+        uint32_t state = 0x2545f491;
+
+        for(uint32_t length = 1; length <= max_length; ++length)
+        {
+                uint32_t all = length >= 32 ? UINT32_MAX : (1u << length) - 1;
+                uint32_t patterns = length <= exhaustive_length ? all + 1 : samples;
+                for(uint32_t p = 0; p < patterns; ++p)
+                {
+                        // Bits above the length must be ignored, so leave some set
+                        uint32_t pattern = length <= exhaustive_length ? p | (next(state) & ~all) : next(state);
+                        for(int rotate = 0; rotate < 2; ++rotate)
+                        {
+                                for(uint32_t k : ks)
+                                {
+                                        Match expected[32], scalar[32], vector[32];
+                                        uint32_t expected_found = bruteForce(length, pattern & all, rotate, expected,
+                                                                             k);
+
+                                        useVectorSearch(false);
+                                        uint32_t scalar_found = findNearest(length, pattern, rotate, scalar, k);
+                                        useVectorSearch(true);
+                                        uint32_t vector_found = findNearest(length, pattern, rotate, vector, k);
+
+                                        bool ok = same(expected, expected_found, scalar, scalar_found) &&
+                                                  same(expected, expected_found, vector, vector_found);
+                                        if(!ok && mismatches++ < 20)
+                                        {
+                                                printf("Search differs: length %u pattern %08x rotate %d k %u, "
+                                                       "found %u brute force, %u scalar, %u vector\n",
+                                                       length, pattern, rotate, k, expected_found, scalar_found,
+                                                       vector_found);
+                                        }
+                                        ++searches;
+                                }
+                        }
+                }
+        }
+
+        printf("%llu searches, %llu mismatches%s\n", searches, mismatches,
+               avx2 ? "" : " (no AVX2 on this CPU, only the scalar kernel was checked)");
+
+        uint32_t checksum = 0;
+        printf("findNearest, length %u, k = 8\n", max_length);
+        printf("  Hamming       %6.2f us %s, %6.2f us scalar\n", timeSearch(false, true, &checksum),
+               avx2 ? "AVX2" : "default", timeSearch(false, false, &checksum));
+        printf("  All rotations %6.2f us %s, %6.2f us scalar\n", timeSearch(true, true, &checksum),
+               avx2 ? "AVX2" : "default", timeSearch(true, false, &checksum));
+        printf("  (checksum %08x)\n", checksum);
+
+        return mismatches ? 1 : 0;
+}
@@ -0,0 +1,292 @@
+#!/usr/bin/python3
+'''
+Generates the panels for the expander modules, the Expander
+(res/expander-*-panel.svg) and the Polygene Bank (res/polygene-bank-*-panel.svg).
+
+Text is converted to paths using the bundled Share Tech Mono font because
+Rack can't render SVG text elements. The hidden "components" layer follows
+the same conventions as the Inkscape panels so OrbitsConfig can find the
+position of each component by its label.
+
+Usage: python3 scripts/expander_panel.py
+'''
+
+import os
+import struct
+
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..')
+FONT = os.path.join(ROOT, 'res', 'fonts', 'ShareTechMono-Regular.ttf')
+
+WIDTH = 30.48
+HEIGHT = 128.5
+INPUT_X = 8.89
+OUTPUT_X = 21.59
+FIRST_ROW_Y = 27.0
+ROW_SPACING = 13.0
+PORT_RADIUS = 4.84
+LABEL_SIZE = 3.2
+TITLE_SIZE = 4.2
+
+# name: (title, [(component, label, column, row), ...])
+# Inputs live in the left column, outputs in the right column.
+PANELS = {
+    'expander': ('EXPANDER', [
+        ('swing_cv_port', 'SWING', 'input', 0),
+        ('scene_cv_port', 'SCENE', 'input', 1),
+        ('morph_cv_port', 'MORPH', 'input', 2),
+        ('tempo_cv_port', 'BPM', 'input', 3),
+        ('preset_cv_port', 'PRESET', 'input', 4),
+        ('next_port', 'NEXT', 'output', 0),
+        ('ramp_port', 'RAMP', 'output', 1),
+        ('even_port', 'EVEN', 'output', 2),
+        ('off_beat_port', 'OFF', 'output', 3),
+        ('density_port', 'DENS', 'output', 4),
+        ('odd_port', 'ODD', 'output', 5),
+        ('accent_port', 'ACC', 'output', 6),
+    ]),
+    'polygene-bank': ('BANK', [
+        ('beat_port', 'OUT', 'output', 0),
+        ('eoc_port', 'EOC', 'output', 1),
+    ]),
+}
+
+THEMES = {
+    'dark': {
+        'background_top': '#262626',
+        'background_bottom': '#1c1c1c',
+        'text': '#f5f5f5',
+        'box_fill': '#0a0a0a',
+        'box_stroke': '#cccccc',
+        'line': '#737373',
+    },
+    'light': {
+        'background_top': '#f0f0f0',
+        'background_bottom': '#dbdbdb',
+        'text': '#242424',
+        'box_fill': '#ffffff',
+        'box_stroke': '#666666',
+        'line': '#737373',
+    },
+}
+
+
+class Font:
+    '''
+    Minimal TrueType reader, only enough to turn simple glyph outlines into SVG paths.
+    '''
+    def __init__(self, path):
+        with open(path, 'rb') as f:
+            self.data = f.read()
+        self.tables = {}
+        num_tables = struct.unpack('>H', self.data[4:6])[0]
+        for i in range(num_tables):
+            tag, _, offset, length = struct.unpack('>4sIII', self.data[12 + 16 * i:28 + 16 * i])
+            self.tables[tag.decode()] = (offset, length)
+
+        head = self.tables['head'][0]
+        self.units_per_em = struct.unpack('>H', self.data[head + 18:head + 20])[0]
+        self.long_loca = struct.unpack('>h', self.data[head + 50:head + 52])[0] == 1
+
+        hhea = self.tables['hhea'][0]
+        self.num_hmetrics = struct.unpack('>H', self.data[hhea + 34:hhea + 36])[0]
+
+        self.cmap = self._readCmap()
+
+    def _readCmap(self):
+        cmap = self.tables['cmap'][0]
+        num = struct.unpack('>H', self.data[cmap + 2:cmap + 4])[0]
+        for i in range(num):
+            platform, encoding, offset = struct.unpack('>HHI', self.data[cmap + 4 + 8 * i:cmap + 12 + 8 * i])
+            sub = cmap + offset
+            if struct.unpack('>H', self.data[sub:sub + 2])[0] == 4 and platform in (0, 3):
+                return self._readFormat4(sub)
+        raise ValueError('No format 4 cmap')
+
+    def _readFormat4(self, sub):
+        seg_x2 = struct.unpack('>H', self.data[sub + 6:sub + 8])[0]
+        segs = seg_x2 // 2
+        ends = struct.unpack(f'>{segs}H', self.data[sub + 14:sub + 14 + seg_x2])
+        starts_off = sub + 16 + seg_x2
+        starts = struct.unpack(f'>{segs}H', self.data[starts_off:starts_off + seg_x2])
+        deltas = struct.unpack(f'>{segs}h', self.data[starts_off + seg_x2:starts_off + 2 * seg_x2])
+        range_off = starts_off + 2 * seg_x2
+        ranges = struct.unpack(f'>{segs}H', self.data[range_off:range_off + seg_x2])
+        mapping = {}
+        for s in range(segs):
+            for c in range(starts[s], ends[s] + 1):
+                if c == 0xffff:
+                    continue
+                if ranges[s] == 0:
+                    g = (c + deltas[s]) & 0xffff
+                else:
+                    addr = range_off + 2 * s + ranges[s] + 2 * (c - starts[s])
+                    g = struct.unpack('>H', self.data[addr:addr + 2])[0]
+                    if g:
+                        g = (g + deltas[s]) & 0xffff
+                mapping[chr(c)] = g
+        return mapping
+
+    def advance(self, glyph):
+        hmtx = self.tables['hmtx'][0]
+        glyph = min(glyph, self.num_hmetrics - 1)
+        return struct.unpack('>H', self.data[hmtx + 4 * glyph:hmtx + 4 * glyph + 2])[0]
+
+    def _glyphOffset(self, glyph):
+        loca = self.tables['loca'][0]
+        if self.long_loca:
+            start, end = struct.unpack('>II', self.data[loca + 4 * glyph:loca + 4 * glyph + 8])
+        else:
+            start, end = struct.unpack('>HH', self.data[loca + 2 * glyph:loca + 2 * glyph + 4])
+            start *= 2
+            end *= 2
+        return self.tables['glyf'][0] + start, end - start
+
+    def contours(self, glyph):
+        offset, length = self._glyphOffset(glyph)
+        if length == 0:
+            return []
+        num_contours = struct.unpack('>h', self.data[offset:offset + 2])[0]
+        if num_contours < 0:
+            raise ValueError('Composite glyphs are not supported')
+        p = offset + 10
+        end_points = struct.unpack(f'>{num_contours}H', self.data[p:p + 2 * num_contours])
+        p += 2 * num_contours
+        instruction_length = struct.unpack('>H', self.data[p:p + 2])[0]
+        p += 2 + instruction_length
+        num_points = end_points[-1] + 1
+
+        flags = []
+        while len(flags) < num_points:
+            flag = self.data[p]
+            p += 1
+            flags.append(flag)
+            if flag & 8:
+                repeat = self.data[p]
+                p += 1
+                flags.extend([flag] * repeat)
+
+        def readCoords(short_bit, same_bit):
+            nonlocal p
+            values = []
+            value = 0
+            for flag in flags:
+                if flag & short_bit:
+                    delta = self.data[p]
+                    p += 1
+                    value += delta if flag & same_bit else -delta
+                elif not flag & same_bit:
+                    value += struct.unpack('>h', self.data[p:p + 2])[0]
+                    p += 2
+                values.append(value)
+            return values
+
+        xs = readCoords(2, 16)
+        ys = readCoords(4, 32)
+
+        contours = []
+        start = 0
+        for end in end_points:
+            contours.append([(xs[i], ys[i], bool(flags[i] & 1)) for i in range(start, end + 1)])
+            start = end + 1
+        return contours
+
+
+def glyphPath(font, glyph, x, y, scale):
+    def pt(px, py):
+        return f'{x + px * scale:.4f},{y - py * scale:.4f}'
+
+    d = []
+    for contour in font.contours(glyph):
+        # Make sure the contour starts on an on-curve point
+        if not contour[0][2]:
+            if contour[-1][2]:
+                contour = contour[-1:] + contour[:-1]
+            else:
+                mid = ((contour[0][0] + contour[-1][0]) / 2, (contour[0][1] + contour[-1][1]) / 2, True)
+                contour = [mid] + contour
+        d.append('M' + pt(contour[0][0], contour[0][1]))
+        points = contour[1:] + contour[:1]
+        prev_off = None
+        for px, py, on in points:
+            if on:
+                if prev_off:
+                    d.append('Q' + pt(*prev_off) + ' ' + pt(px, py))
+                else:
+                    d.append('L' + pt(px, py))
+                prev_off = None
+            else:
+                if prev_off:
+                    mid = ((prev_off[0] + px) / 2, (prev_off[1] + py) / 2)
+                    d.append('Q' + pt(*prev_off) + ' ' + pt(*mid))
+                prev_off = (px, py)
+        d.append('Z')
+    return ''.join(d)
+
+
+def textPath(font, text, cx, baseline, size):
+    '''
+    Returns an SVG path for text horizontally centered on cx.
+    '''
+    scale = size / font.units_per_em
+    glyphs = [font.cmap[c] for c in text]
+    width = sum(font.advance(g) for g in glyphs) * scale
+    x = cx - width / 2
+    d = []
+    for g in glyphs:
+        d.append(glyphPath(font, g, x, baseline, scale))
+        x += font.advance(g) * scale
+    return ''.join(d)
+
+
+def panel(font, theme, title, ports):
+    t = THEMES[theme]
+    svg = []
+    svg.append('<?xml version="1.0" encoding="UTF-8" standalone="no"?>')
+    svg.append(f'<svg width="{WIDTH}mm" height="{HEIGHT}mm" viewBox="0 0 {WIDTH} {HEIGHT}" version="1.1" '
+               'xmlns="http://www.w3.org/2000/svg" '
+               'xmlns:inkscape="http://www.inkscape.org/namespaces/inkscape">')
+    svg.append('<defs>')
+    svg.append(f'<linearGradient id="background" gradientUnits="userSpaceOnUse" x1="0" y1="{HEIGHT}" x2="0" y2="0">'
+               f'<stop offset="0" style="stop-color:{t["background_bottom"]};stop-opacity:1"/>'
+               f'<stop offset="1" style="stop-color:{t["background_top"]};stop-opacity:1"/>'
+               '</linearGradient>')
+    svg.append('</defs>')
+
+    svg.append('<g inkscape:label="Layer 1" inkscape:groupmode="layer" id="layer1">')
+    svg.append(f'<rect style="fill:url(#background);stroke:none" width="{WIDTH}" height="{HEIGHT}" x="0" y="0"/>')
+    svg.append(f'<path style="fill:{t["text"]};stroke:none" d="{textPath(font, title, WIDTH / 2, 11.5, TITLE_SIZE)}"/>')
+    svg.append(f'<path style="fill:none;stroke:{t["line"]};stroke-width:0.2" d="M 3,15 H {WIDTH - 3}"/>')
+
+    for _, label, column, row in ports:
+        x = INPUT_X if column == 'input' else OUTPUT_X
+        y = FIRST_ROW_Y + row * ROW_SPACING
+        if column == 'output':
+            svg.append(f'<rect style="fill:{t["box_fill"]};fill-opacity:0.447;stroke:{t["box_stroke"]};stroke-width:0.2" '
+                       f'width="11.6" height="12.8" x="{x - 5.8:.3f}" y="{y - 8.4:.3f}" ry="1.8"/>')
+        svg.append(f'<path style="fill:{t["text"]};stroke:none" '
+                   f'd="{textPath(font, label, x, y - 5.4, LABEL_SIZE)}"/>')
+
+    svg.append(f'<path style="fill:{t["text"]};stroke:none" '
+               f'd="{textPath(font, "RARE", WIDTH / 2, HEIGHT - 12.5, LABEL_SIZE)}"/>')
+    svg.append(f'<path style="fill:{t["text"]};stroke:none" '
+               f'd="{textPath(font, "BREEDS", WIDTH / 2, HEIGHT - 9.0, LABEL_SIZE)}"/>')
+    svg.append('</g>')
+
+    svg.append('<g inkscape:groupmode="layer" id="layer2" inkscape:label="components" style="display:none">')
+    for component, _, column, row in ports:
+        x = INPUT_X if column == 'input' else OUTPUT_X
+        y = FIRST_ROW_Y + row * ROW_SPACING
+        fill = '#00ff00' if column == 'input' else '#0000ff'
+        svg.append(f'<circle style="fill:{fill};stroke:none" cx="{x}" cy="{y}" r="{PORT_RADIUS}" '
+                   f'inkscape:label="{component}"/>')
+    svg.append('</g>')
+    svg.append('</svg>')
+    return '\n'.join(svg) + '\n'
+
+
+if __name__ == '__main__':
+    font = Font(FONT)
+    for name, (title, ports) in PANELS.items():
+        for theme in THEMES:
+            with open(os.path.join(ROOT, 'res', f'{name}-{theme}-panel.svg'), 'w') as f:
+                f.write(panel(font, theme, title, ports))
@@ -0,0 +1,116 @@
+#!/usr/bin/python3
+'''
+Exports the golden output of the Python rhythm model for
+scripts/validate_rhythm.cpp, which checks src/Rhythm.cpp against it.
+
+Every (length, density, variation, shift, invert) the modules can ask for is
+enumerated. The near even rhythms come from the table in src/rhythm_table.h
+because growGraph() searches at random and can't reproduce it, so the table
+is checked against the model instead: the density of each rhythm, the first
+variation being the maximally even rhythm and each variation being one move
+away from the one before. Rotation, inversion and the analysis measures are
+all worked out by the model.
+
+Export the golden file before replacing the table or changing how it's
+stored, so the new code is compared against the old output.
+
+Usage: python3 scripts/rhythm_golden.py [golden file] [table header]
+
+The golden file is little endian: the magic 'ORBR', the version, the
+maximum length, the number of patterns and the nanoseconds the model took.
+Then for each length and density, the maximally even word and the number of
+variations, and for each variation the inter-onset vector (max length / 2
+bytes), evenness, off-beatness (floats), odd (byte) and a word for each
+shift, then each inverted shift.
+'''
+
+import os
+import re
+import struct
+import sys
+import time
+
+from rhythm import Rhythm
+
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..')
+MAX_LENGTH = 32
+VERSION = 1
+
+
+def readTable(path):
+    with open(path) as f:
+        text = f.read()
+
+    def array(name):
+        values = re.search(name + r'\[\] = \{([^}]*)\}', text).group(1)
+        return [int(v, 0) for v in values.split(',')]
+
+    rhythms = array('neareven_rhythms')
+    offsets = array('neareven_offsets')
+    counts = array('neareven_count')
+
+    # Indexed like Rhythm.cpp, every density of a length follows the one before
+    table = {}
+    index = 0
+    for length in range(1, MAX_LENGTH + 1):
+        for density in range(length + 1):
+            table[length, density] = rhythms[offsets[index]:offsets[index] + counts[index]]
+            index += 1
+    return table
+
+
+def checkTable(table):
+    errors = []
+    for (length, density), words in table.items():
+        rhythms = [Rhythm.fromInt(length, w) for w in words]
+        if any(r.density != density for r in rhythms):
+            errors.append(f'{length} {density}: wrong density')
+        if rhythms[0] != Rhythm.maximallyEven(length, density):
+            errors.append(f'{length} {density}: first variation is not maximally even')
+        for v in range(1, len(rhythms)):
+            if rhythms[v].distance(rhythms[v - 1]) != 1:
+                errors.append(f'{length} {density}: variation {v} is not one move from the one before')
+    return errors
+
+
+def export(table):
+    data = bytearray()
+    patterns = 0
+    start = time.perf_counter_ns()
+    for length in range(1, MAX_LENGTH + 1):
+        for density in range(length + 1):
+            words = table[length, density]
+            data += struct.pack('<II', int(Rhythm.maximallyEven(length, density)), len(words))
+            for word in words:
+                rhythm = Rhythm.fromInt(length, word)
+                inter_onset = rhythm.inter_onset_vector
+                inter_onset += [0] * (MAX_LENGTH // 2 - len(inter_onset))
+                data += bytes(inter_onset)
+                data += struct.pack('<ffB', rhythm.evenness, rhythm.off_beatness, rhythm.is_odd)
+
+                rotations = [rhythm.rotate(shift) for shift in range(length)]
+                for invert in (False, True):
+                    for r in rotations:
+                        data += struct.pack('<I', int(~r if invert else r))
+                patterns += 2 * length
+    elapsed = time.perf_counter_ns() - start
+
+    header = b'ORBR' + struct.pack('<IIIQ', VERSION, MAX_LENGTH, patterns, elapsed)
+    return header + data, patterns, elapsed
+
+
+if __name__ == '__main__':
+    golden = sys.argv[1] if len(sys.argv) > 1 else os.path.join(ROOT, 'build', 'rhythm_golden.bin')
+    header = sys.argv[2] if len(sys.argv) > 2 else os.path.join(ROOT, 'src', 'rhythm_table.h')
+
+    table = readTable(header)
+    errors = checkTable(table)
+    for e in errors:
+        print(e)
+
+    data, patterns, elapsed = export(table)
+    os.makedirs(os.path.dirname(os.path.abspath(golden)), exist_ok=True)
+    with open(golden, 'wb') as f:
+        f.write(data)
+    print(f'{patterns} patterns in {elapsed / 1e9:.2f} s, {elapsed / patterns:.0f} ns per pattern')
+    sys.exit(1 if errors else 0)
@@ -0,0 +1,323 @@
+// Checks the rhythm kernels in src/Rhythm.cpp against the golden output of the
+// Python model exported by scripts/rhythm_golden.py, and times both.
+//
+// Every (length, density, variation, shift, invert) is built the way the
+// modules build it, as a pattern word through rotate() and word() and step by
+// step through nearEvenRhythmBeat() and beat(), and compared bit for bit. The
+// analysis of each rhythm is compared too, the floats within a small tolerance
+// because the model works in doubles. Nested patterns are checked against a step
+// by step model, with outer and inner lengths whose product is over 32.
+//
+// Usage: make validate-rhythm
+//    or: c++ -O2 -Isrc scripts/validate_rhythm.cpp src/Rhythm.cpp -o build/validate_rhythm
+//        build/validate_rhythm [golden file]
+
+#include "Rhythm.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace rhythm;
+
+struct Golden
+{
+        std::vector<uint8_t> m_data;
+        size_t m_pos = 0;
+
+        bool load(const char *path)
+        {
+                FILE *file = fopen(path, "rb");
+                if(!file)
+                {
+                        return false;
+                }
+                uint8_t buffer[65536];
+                size_t n;
+                while((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+                {
+                        m_data.insert(m_data.end(), buffer, buffer + n);
+                }
+                fclose(file);
+                return true;
+        }
+
+        template <typename T>
+        T read(void)
+        {
+                // Little endian like every platform Rack runs on
+                T value = T();
+                if(m_pos + sizeof(T) <= m_data.size())
+                {
+                        memcpy(&value, &m_data[m_pos], sizeof(T));
+                }
+                m_pos += sizeof(T);
+                return value;
+        }
+
+        bool overrun(void) const
+        {
+                return m_pos > m_data.size();
+        }
+};
+
+struct Mismatches
+{
+        unsigned long long m_count = 0;
+
+        void report(const char *what, uint32_t length, uint32_t density, uint32_t variation, uint32_t shift,
+                    bool invert, double expected, double actual)
+        {
+                // Only the first few are worth reading
+                if(m_count++ < 20)
+                {
+                        printf("%s differs: length %u density %u variation %u shift %u invert %d, expected %g got %g\n",
+                               what, length, density, variation, shift, invert, expected, actual);
+                }
+        }
+};
+
+static bool approximatelyEqual(float expected, float actual)
+{
+        return std::fabs(expected - actual) <= 1e-4f * std::max(1.f, std::fabs(expected));
+}
+
+static uint32_t modulePattern(uint32_t length, uint32_t density, uint32_t variation, uint32_t shift, bool invert)
+{
+        // As PatternCache::update() builds it
+        Rhythm pattern = rotate(nearEvenRhythm(length, density, variation), length, shift);
+        if(invert)
+        {
+                pattern.flip();
+        }
+        return word(pattern, length);
+}
+
+// xorshift32, so every run nests the same patterns
+static uint32_t next(uint32_t &state)
+{
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+}
+
+// Checks nest() step by step for every pair of lengths, including the ones whose product is over max_length
+static unsigned long long checkNest(void)
+{
+        unsigned long long mismatches = 0;
+        uint32_t state = 0x2545f491;
+        for(uint32_t outer_length = 1; outer_length <= max_length; ++outer_length)
+        {
+                for(uint32_t inner_length = 1; inner_length <= max_length; ++inner_length)
+                {
+                        // Every outer step that fits must be kept, a step that plays nothing can't hide this
+                        uint32_t outer_steps = std::min(outer_length, std::max(1u, max_length / inner_length));
+                        uint32_t outers[] = {UINT32_MAX, next(state), next(state)};
+                        uint32_t inners[] = {1, next(state), next(state)};
+                        for(uint32_t outer : outers)
+                        {
+                                for(uint32_t inner : inners)
+                                {
+                                        uint32_t length;
+                                        uint32_t nested = nest(outer, outer_length, inner, inner_length, &length);
+                                        uint32_t expected = 0;
+                                        for(uint32_t step = 0; step < outer_steps * inner_length; ++step)
+                                        {
+                                                bool on = (outer >> (step / inner_length) & 1) &&
+                                                          (inner >> (step % inner_length) & 1);
+                                                expected |= (uint32_t)on << step;
+                                        }
+                                        if((length != outer_steps * inner_length || nested != expected) &&
+                                           mismatches++ < 20)
+                                        {
+                                                printf("Nest differs: outer %08x length %u, inner %08x length %u, "
+                                                       "expected %08x length %u got %08x length %u\n",
+                                                       outer, outer_length, inner, inner_length, expected,
+                                                       outer_steps * inner_length, nested, length);
+                                        }
+                                }
+                        }
+                }
+        }
+        return mismatches;
+}
+
+int main(int argc, char **argv)
+{
+        const char *path = argc > 1 ? argv[1] : "build/rhythm_golden.bin";
+        Golden golden;
+        if(!golden.load(path))
+        {
+                printf("Couldn't read %s, export it with scripts/rhythm_golden.py\n", path);
+                return 1;
+        }
+
+        char magic[4];
+        for(char &c : magic)
+        {
+                c = golden.read<char>();
+        }
+        uint32_t version = golden.read<uint32_t>();
+        uint32_t golden_length = golden.read<uint32_t>();
+        uint32_t golden_patterns = golden.read<uint32_t>();
+        uint64_t model_ns = golden.read<uint64_t>();
+        if(memcmp(magic, "ORBR", 4) || version != 1 || golden_length != max_length)
+        {
+                printf("%s isn't a golden file for this version\n", path);
+                return 1;
+        }
+
+        Mismatches mismatches;
+        unsigned long long patterns = 0;
+        for(uint32_t length = 1; length <= max_length; ++length)
+        {
+                for(uint32_t density = 0; density <= length; ++density)
+                {
+                        uint32_t even = golden.read<uint32_t>();
+                        uint32_t count = golden.read<uint32_t>();
+                        if(word(rhythm::rhythm(length, density), length) != even)
+                        {
+                                mismatches.report("Maximally even rhythm", length, density, 0, 0, false, even,
+                                                  word(rhythm::rhythm(length, density), length));
+                        }
+                        if(nearEvenWord(length, density) != even)
+                        {
+                                mismatches.report("Near even word", length, density, 0, 0, false, even,
+                                                  nearEvenWord(length, density));
+                        }
+                        if(numNearEvenRhythms(length, density) != count)
+                        {
+                                mismatches.report("Number of variations", length, density, 0, 0, false, count,
+                                                  numNearEvenRhythms(length, density));
+                                // The rest of the file can't be lined up with the table
+                                printf("%llu mismatches\n", mismatches.m_count);
+                                return 1;
+                        }
+
+                        for(uint32_t variation = 0; variation < count; ++variation)
+                        {
+                                uint32_t base = word(nearEvenRhythm(length, density, variation), length);
+                                Analysis analysis = analyse(length, base);
+                                for(uint32_t k = 0; k < max_length / 2; ++k)
+                                {
+                                        uint8_t expected = golden.read<uint8_t>();
+                                        if(analysis.inter_onset[k] != expected)
+                                        {
+                                                mismatches.report("Inter-onset vector", length, density, variation,
+                                                                  0, false, expected, analysis.inter_onset[k]);
+                                        }
+                                }
+                                float evenness = golden.read<float>();
+                                float off_beatness = golden.read<float>();
+                                bool odd = golden.read<uint8_t>();
+                                if(!approximatelyEqual(evenness, analysis.evenness))
+                                {
+                                        mismatches.report("Evenness", length, density, variation, 0, false,
+                                                          evenness, analysis.evenness);
+                                }
+                                if(!approximatelyEqual(off_beatness, analysis.off_beatness))
+                                {
+                                        mismatches.report("Off-beatness", length, density, variation, 0, false,
+                                                          off_beatness, analysis.off_beatness);
+                                }
+                                if(odd != analysis.odd)
+                                {
+                                        mismatches.report("Oddness", length, density, variation, 0, false, odd,
+                                                          analysis.odd);
+                                }
+
+                                for(int invert = 0; invert < 2; ++invert)
+                                {
+                                        for(uint32_t shift = 0; shift < length; ++shift)
+                                        {
+                                                uint32_t expected = golden.read<uint32_t>();
+                                                uint32_t pattern = modulePattern(length, density, variation, shift,
+                                                                                 invert);
+                                                if(pattern != expected)
+                                                {
+                                                        mismatches.report("Pattern", length, density, variation,
+                                                                          shift, invert, expected, pattern);
+                                                }
+
+                                                uint32_t rotated = rotateWord(base, length, shift);
+                                                if(invert)
+                                                {
+                                                        rotated = word(~Rhythm(rotated), length);
+                                                }
+                                                if(rotated != expected)
+                                                {
+                                                        mismatches.report("Rotated word", length, density,
+                                                                          variation, shift, invert, expected, rotated);
+                                                }
+
+                                                uint32_t steps = 0;
+                                                for(uint32_t num = 0; num < length; ++num)
+                                                {
+                                                        bool on = nearEvenRhythmBeat(length, density, variation, shift,
+                                                                                     num) != (bool)invert;
+                                                        steps |= (uint32_t)on << num;
+                                                        if(variation == 0 &&
+                                                           beat(length, density, shift, num, invert) != on)
+                                                        {
+                                                                mismatches.report("Beat", length, density, 0,
+                                                                                  shift, invert, on, !on);
+                                                        }
+                                                }
+                                                if(steps != expected)
+                                                {
+                                                        mismatches.report("Steps", length, density, variation,
+                                                                          shift, invert, expected, steps);
+                                                }
+                                                ++patterns;
+                                        }
+                                }
+                        }
+                }
+        }
+
+        if(golden.overrun() || golden.m_pos != golden.m_data.size() || patterns != golden_patterns)
+        {
+                printf("%s doesn't match the table, export it again\n", path);
+                return 1;
+        }
+
+        mismatches.m_count += checkNest();
+
+        // Time the pattern words the modules use, enough passes to take a measurable time
+        auto begin = std::chrono::steady_clock::now();
+        uint32_t checksum = 0;
+        int passes = 20;
+        for(int pass = 0; pass < passes; ++pass)
+        {
+                for(uint32_t length = 1; length <= max_length; ++length)
+                {
+                        for(uint32_t density = 0; density <= length; ++density)
+                        {
+                                uint32_t count = numNearEvenRhythms(length, density);
+                                for(uint32_t variation = 0; variation < count; ++variation)
+                                {
+                                        for(int invert = 0; invert < 2; ++invert)
+                                        {
+                                                for(uint32_t shift = 0; shift < length; ++shift)
+                                                {
+                                                        checksum += modulePattern(length, density, variation, shift,
+                                                                                  invert);
+                                                }
+                                        }
+                                }
+                        }
+                }
+        }
+        double cpp_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count() /
+                        ((double)patterns * passes);
+        double python_ns = (double)model_ns / patterns;
+
+        printf("%llu patterns, %llu mismatches\n", patterns, mismatches.m_count);
+        printf("Python model export %.0f ns per pattern, Rhythm.cpp %.2f ns per pattern (checksum %08x)\n", python_ns,
+               cpp_ns, checksum);
+        return mismatches.m_count ? 1 : 0;
+}
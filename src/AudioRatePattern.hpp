@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Rhythm.hpp"
+
+#include <cstdint>
+
+// Plays a rhythm every sample for audio rate clocks and CV. Written without
+// branches on the signal so the cost is the same for any input. Nothing here
+// needs Rack, so scripts/bench_audio_rate.cpp builds it standalone.
+struct AudioRatePattern
+{
+        uint32_t m_step = 0;
+        uint32_t m_played = 0;
+        bool m_high = false;
+
+        // The gates follow the clock, beat is high while the clock is high on an on beat
+        // and eoc is high while the clock is high on the last step
+        void process(float clock, bool sync, uint32_t length, uint32_t hits, uint32_t shift, bool reverse,
+                     bool invert, bool *beat, bool *eoc)
+        {
+                // Schmitt trigger with the same thresholds as dsp::SchmittTrigger
+                bool high = (clock >= 1.f) | (m_high & (clock > 0.f));
+                uint32_t edge = high & !m_high;
+                m_high = high;
+
+                // Sync goes back to the first step, the length may have changed since the last sample
+                uint32_t step = m_step & -(uint32_t)!sync;
+                step -= (step >= length) * step;
+
+                // Forwards plays the step then moves on, backwards moves back then plays it
+                uint32_t next = step + 1;
+                next -= (next >= length) * length;
+                uint32_t previous = step + length - 1;
+                previous -= (previous >= length) * length;
+                m_played = edge ? (reverse ? previous : step) : m_played;
+                m_played -= (m_played >= length) * m_played;
+                m_step = edge ? (reverse ? previous : next) : step;
+
+                uint32_t pattern = rhythm::rotateWord(rhythm::nearEvenWord(length, hits), length, shift);
+                uint32_t last = reverse ? 0 : length - 1;
+                *beat = high & (((pattern >> m_played) & 1) != invert);
+                *eoc = high & (m_played == last);
+        }
+};
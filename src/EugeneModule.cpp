@@ -1,5 +1,6 @@
 #include "EugeneModule.hpp"
 #include "EugeneWidget.hpp"
+#include "ExpanderModule.hpp"
 #include "Rhythm.hpp"
 
 static unsigned int clampRounded(float value, unsigned int min, unsigned int max)
@@ -29,6 +30,9 @@ RareBreeds_Orbits_Eugene::RareBreeds_Orbits_Eugene()
         configSwitch(REVERSE_KNOB_PARAM, 0.f, 1.f, 0.f, "Reverse", {"Off", "On"});
         configSwitch(INVERT_KNOB_PARAM, 0.f, 1.f, 0.f, "Invert", {"Off", "On"});
         configButton(SYNC_KNOB_PARAM, "Sync");
+        configParam(SWING_PARAM, 0.f, 0.5f, 0.f, "Swing", "% of clock period", 0.f, 100.f);
+        configParam(MORPH_PARAM, 0.f, 1.f, 0.f, "Morph target hits", "%", 0.f, 100.f);
+        configParam(TEMPO_PARAM, -2.f, 2.f, 0.f, "Internal clock tempo", " BPM", 2.f, 120.f);
 
         configInput(CLOCK_INPUT, "Clock");
         configInput(SYNC_INPUT, "Sync");
@@ -43,16 +47,47 @@ RareBreeds_Orbits_Eugene::RareBreeds_Orbits_Eugene()
         configOutput(EOC_OUTPUT, "End of cycle");
 
         configBypass(CLOCK_INPUT, BEAT_OUTPUT);
+
+        m_expander.init(this);
 }
 
 EugeneDisplayData RareBreeds_Orbits_Eugene::getDisplayData(void)
 {
         EugeneDisplayData data;
-        data.length = readLength();
-        data.hits = readHits(data.length);
-        data.shift = readShift(data.length);
-        data.reverse = readReverse();
-        data.invert = readInvert();
+        const Song::CompiledList *song = m_song.playing();
+        if(song)
+        {
+                const Song::Compiled &entry = m_song.current(*song);
+                data.length = entry.length;
+                data.hits = entry.hits;
+                data.shift = entry.shift;
+                data.reverse = entry.reverse;
+                data.invert = entry.invert;
+                data.pattern = entry.pattern;
+                data.current_step = m_current_step > data.length - 1 ? 0 : m_current_step;
+                return data;
+        }
+
+        data.reverse = isReversed();
+        if(m_pattern.m_morphed && isMorphing())
+        {
+                // The morphed pattern playing, hits are counted before it's shifted and inverted
+                data.length = m_pattern.m_length;
+                data.hits = __builtin_popcount(m_morph.at(m_pattern.m_position));
+                data.shift = m_pattern.m_shift;
+                data.invert = m_pattern.m_invert;
+                data.pattern = m_pattern.m_word;
+        }
+        else
+        {
+                data.length = readLength();
+                data.hits = readHits(data.length);
+                data.shift = readShift(data.length);
+                data.invert = isInverted();
+                PatternCache pattern;
+                pattern.update(data.length, data.hits, data.shift, 0, data.invert);
+                data.pattern = pattern.m_word;
+        }
         data.current_step = m_current_step > data.length - 1 ? 0 : m_current_step;
         return data;
 }
@@ -61,7 +96,7 @@ EugeneDisplayData RareBreeds_Orbits_Eugene::getDisplayData(RareBreeds_Orbits_Eug
 {
         if(module)
         {
-                return module->getDisplayData();
+                return module->m_display.read();
         }
         else
         {
@@ -72,6 +107,7 @@ EugeneDisplayData RareBreeds_Orbits_Eugene::getDisplayData(RareBreeds_Orbits_Eug
                 data.current_step = 0;
                 data.reverse = false;
                 data.invert = false;
+                data.pattern = rhythm::nearEvenWord(data.length, data.hits);
                 return data;
         }
 }
@@ -134,16 +170,89 @@ bool RareBreeds_Orbits_Eugene::readInvert()
         }
 }
 
-void RareBreeds_Orbits_Eugene::process(const ProcessArgs &args)
+bool RareBreeds_Orbits_Eugene::isReversed()
 {
-        if(m_sync_trigger.process(getInput(SYNC_INPUT).getVoltage()))
+        if(getInput(REVERSE_CV_INPUT).isConnected())
         {
-                m_current_step = 0;
+                return m_reverse_trigger.isHigh();
+        }
+        else
+        {
+                return getParam(REVERSE_KNOB_PARAM).getValue() > 0.5f;
+        }
+}
+
+bool RareBreeds_Orbits_Eugene::isInverted()
+{
+        if(getInput(INVERT_CV_INPUT).isConnected())
+        {
+                return m_invert_trigger.isHigh();
+        }
+        else
+        {
+                return getParam(INVERT_KNOB_PARAM).getValue() > 0.5f;
+        }
+}
+
+float RareBreeds_Orbits_Eugene::readSwingOffset()
+{
+        // Per step offset from the expander, 1V is 10% of the clock period
+        if(m_expander.isAttached())
+        {
+                return m_expander.getVoltage(RareBreeds_Orbits_Expander::SWING_CV_INPUT) / 10.f;
+        }
+        return 0.f;
+}
+
+bool RareBreeds_Orbits_Eugene::isMorphing()
+{
+        return m_expander.isAttached() && m_expander.isConnected(RareBreeds_Orbits_Expander::MORPH_CV_INPUT);
+}
+
+float RareBreeds_Orbits_Eugene::readMorph()
+{
+        // 0V plays the rhythm, 10V plays the morph target
+        return m_expander.getVoltage(RareBreeds_Orbits_Expander::MORPH_CV_INPUT) / 10.f;
+}
+
+float RareBreeds_Orbits_Eugene::readTempo()
+{
+        // Beats per second, the expander CV adds 1V per octave like Rack's clock modules
+        float octaves = getParam(TEMPO_PARAM).getValue();
+        if(m_expander.isAttached())
+        {
+                octaves += m_expander.getVoltage(RareBreeds_Orbits_Expander::TEMPO_CV_INPUT);
         }
+        return 2.f * std::exp2(math::clamp(octaves, -5.f, 5.f));
+}
 
+void RareBreeds_Orbits_Eugene::processPreset()
+{
+        bool connected = m_expander.isAttached() && m_expander.isConnected(RareBreeds_Orbits_Expander::PRESET_CV_INPUT);
+        float cv = connected ? m_expander.getVoltage(RareBreeds_Orbits_Expander::PRESET_CV_INPUT) : 0.f;
+        const OrbitsPreset *preset = m_preset.process(connected, cv);
+        if(preset)
+        {
+                // Only the knobs, the context menu settings stay as they are
+                preset->applyParams(this);
+        }
+}
+
+void RareBreeds_Orbits_Eugene::process(const ProcessArgs &args)
+{
+        ORBITS_CAPTURE(m_capture, this, args);
+        ORBITS_PROFILE_ADD(m_profile, SAMPLES, 1);
+        ORBITS_PROFILE_SCOPE(m_profile, PROCESS_TICKS);
+
+        m_expander.process(this);
+        processPreset();
+        const Song::CompiledList *song = m_song.update();
+        m_display.process([this]() {return getDisplayData();});
+
+        bool sync = m_sync_trigger.process(getInput(SYNC_INPUT).getVoltage());
         if(m_sync_button_trigger.process(getParam(SYNC_KNOB_PARAM).getValue() > 0.5f))
         {
-                m_current_step = 0;
+                sync = true;
         }
 
         if(m_random_trigger.process(getInput(RANDOM_CV_INPUT).getVoltage()))
@@ -152,13 +261,114 @@ void RareBreeds_Orbits_Eugene::process(const ProcessArgs &args)
                 onRandomize(e);
         }
 
-        if(m_clock_trigger.process(getInput(CLOCK_INPUT).getVoltage()))
+        float clock_voltage = getInput(CLOCK_INPUT).getVoltage();
+        float previous_clock_voltage = m_clock_voltage;
+        m_clock_voltage = clock_voltage;
+
+        if(m_audio_rate)
+        {
+                if(m_precision)
+                {
+                        // The gates follow the clock so they rise on the high threshold and fall on the low one
+                        float threshold = clock_voltage > previous_clock_voltage ? 1.f : 0.f;
+                        m_edge_position = crossingPosition(previous_clock_voltage, clock_voltage, threshold);
+                }
+                processAudioRate(clock_voltage, sync);
+                return;
+        }
+
+        bool clock = m_clock_trigger.process(clock_voltage);
+        if(clock && m_precision)
+        {
+                m_edge_position = crossingPosition(previous_clock_voltage, clock_voltage, 1.f);
+        }
+
+        if(m_internal_clock)
+        {
+                // A connected clock input syncs the internal clock instead of stepping the rhythm
+                if(getInput(CLOCK_INPUT).isConnected())
+                {
+                        m_master_clock.processExternal(clock);
+                }
+                else
+                {
+                        m_master_clock.process(readTempo(), args.sampleTime);
+                }
+                clock = m_ratio_clock.process(m_master_clock, clock_ratios[default_clock_ratio]);
+                m_edge_position = m_ratio_clock.m_position;
+        }
+
+        // On a bus the clock and sync come from the bus leader
+        m_bus.process(args.frame, &clock, &sync);
+        if(m_bus.isConnected() && !m_bus.isLeader())
+        {
+                // The leader's clock edge isn't known, place the steps on the sample
+                m_edge_position = 0.f;
+        }
+        ORBITS_PROFILE_ADD(m_profile, CLOCK_EDGES, clock);
+        if(clock)
+        {
+                ORBITS_TRACE(m_trace, CLOCK, args.frame, 0, m_current_step);
+        }
+
+        if(sync)
+        {
+                ORBITS_TRACE(m_trace, SYNC, args.frame, 0, 0);
+                m_current_step = 0;
+                m_song.restart();
+        }
+
+        m_swing_delay.step(clock);
+
+        // Between clocks only the morph follows its knob and CV
+        if(!clock && !song && isMorphing())
         {
-                auto length = readLength();
-                auto hits = readHits(length);
-                auto shift = readShift(length);
-                auto reverse = readReverse();
-                auto invert = readInvert();
+                auto target = clampRounded(getParam(MORPH_PARAM).getValue() * m_morph.m_length, 0, m_morph.m_length);
+                m_pattern.followMorph(m_morph, target, readMorph());
+        }
+
+        if(clock)
+        {
+                unsigned int length;
+                bool reverse;
+
+                // A playing song replaces the rhythm parameters with its current entry
+                if(song)
+                {
+                        const Song::Compiled &entry = m_song.current(*song);
+                        length = entry.length;
+                        reverse = entry.reverse;
+                        m_pattern.set(length, entry.pattern);
+                }
+                else
+                {
+                        length = readLength();
+                        auto hits = readHits(length);
+                        auto shift = readShift(length);
+                        reverse = readReverse();
+                        auto invert = readInvert();
+                        if(isMorphing())
+                        {
+                                auto target = clampRounded(getParam(MORPH_PARAM).getValue() * length, 0, length);
+                                m_morph.update(length, hits, 0, target);
+                                m_pattern.morph(m_morph, readMorph(), shift, invert);
+                        }
+                        else
+                        {
+                                bool changed = m_pattern.update(length, hits, shift, 0, invert);
+                                ORBITS_PROFILE_ADD(m_profile, PATTERN_UPDATES, changed);
+                                if(changed)
+                                {
+                                        ORBITS_TRACE(m_trace, PATTERN, args.frame, 0, m_pattern.m_word);
+                                }
+                        }
+                }
+
+                // The step comes from the count of clock edges on the bus
+                if(m_bus.isConnected())
+                {
+                        m_current_step = m_bus.getStep(length, reverse);
+                }
 
                 if(m_current_step >= length)
                 {
@@ -181,9 +391,35 @@ void RareBreeds_Orbits_Eugene::process(const ProcessArgs &args)
                 // If we're going backwards, first is length - 1, last is 0
                 unsigned int first = reverse ? length - 1 : 0;
                 unsigned int last = reverse ? 0 : length - 1;
-                m_eoc_generator.update(m_eoc, m_current_step == first, m_current_step == last);
+                bool eoc = m_eoc_generator.isEndOfCycle(m_eoc, m_current_step == first, m_current_step == last);
+                bool beat = m_pattern.beat(m_current_step);
+                m_analysis.update(m_pattern);
+                m_accent_table.update(m_accent, m_pattern);
+                if(beat)
+                {
+                        m_accent_level = m_accent_table.level(m_current_step);
+                }
+                m_lookahead.update(m_pattern, m_current_step, reverse, m_swing_delay.m_clock.getPeriod());
+
+                m_published.pattern = m_pattern.m_word;
+                m_published.step = m_current_step;
+                m_published.length = length;
+                m_published.on_beat = beat;
+                m_published.reverse = reverse;
+                if(m_current_step == last)
+                {
+                        ++m_published.cycles;
+
+                        if(song)
+                        {
+                                m_song.endOfCycle(*song);
+                        }
+                }
 
-                m_beat_generator.update(rhythm::beat(length, hits, shift, m_current_step, invert));
+                // Swing delays the beat and EOC outputs, with no swing they play immediately
+                float swing = getParam(SWING_PARAM).getValue();
+                float delay = m_swing.delay(m_current_step, swing, readSwingOffset());
+                m_swing_delay.schedule(delay, beat, eoc, m_beat_generator, m_eoc_generator);
 
                 if(!reverse)
                 {
@@ -198,8 +434,79 @@ void RareBreeds_Orbits_Eugene::process(const ProcessArgs &args)
                 }
         }
 
-        getOutput(BEAT_OUTPUT).setVoltage(m_beat_generator.process(m_beat, args.sampleTime) ? 10.f : 0.f);
-        getOutput(EOC_OUTPUT).setVoltage(m_eoc_generator.process(args.sampleTime) ? 10.f : 0.f);
+        m_swing_delay.process(m_beat_generator, m_eoc_generator);
+
+        bool beat = m_beat_generator.process(m_beat, args.sampleTime);
+        bool eoc = m_eoc_generator.process(args.sampleTime);
+#ifdef ORBITS_PROFILE
+        if(m_trace_beat.process(beat))
+        {
+                m_trace.record(OrbitsTraceEvent::BEAT, args.frame, 0, m_published.step);
+        }
+        if(m_trace_eoc.process(eoc))
+        {
+                m_trace.record(OrbitsTraceEvent::EOC, args.frame, 0, m_published.step);
+        }
+#endif
+        writeOutputs(beat ? 10.f : 0.f, eoc ? 10.f : 0.f);
+
+        float ramp = m_lookahead.process();
+        if(m_expander.isAttached())
+        {
+                m_expander.setChannels(1);
+                m_expander.setNextBeat(0, m_lookahead.m_steps, ramp);
+                m_expander.setAnalysis(0, m_analysis.m_evenness, m_analysis.m_off_beatness, m_analysis.m_density,
+                                        m_analysis.m_odd);
+                m_expander.setAccent(0, m_accent_level);
+        }
+
+        publish();
+}
+
+void RareBreeds_Orbits_Eugene::processBypass(const ProcessArgs &args)
+{
+        // The display keeps following the knobs while bypassed
+        m_display.process([this]() {return getDisplayData();});
+        Module::processBypass(args);
+}
+
+void RareBreeds_Orbits_Eugene::processAudioRate(float clock, bool sync)
+{
+        // Every parameter is read each sample, none of the clocked features apply
+        auto length = readLength();
+        auto hits = readHits(length);
+        auto shift = readShift(length);
+        bool beat, eoc;
+        m_audio_rate_pattern.process(clock, sync, length, hits, shift, readReverse(), readInvert(), &beat, &eoc);
+        m_current_step = m_audio_rate_pattern.m_step;
+
+        writeOutputs(beat * 10.f, eoc * 10.f);
+}
+
+void RareBreeds_Orbits_Eugene::writeOutputs(float beat, float eoc)
+{
+        if(m_precision)
+        {
+                float voltages[4] = {beat, eoc};
+                float positions[4] = {m_edge_position, m_edge_position};
+                m_precision_outputs.process(voltages, positions, 2);
+                beat = voltages[0];
+                eoc = voltages[1];
+        }
+
+        getOutput(BEAT_OUTPUT).setVoltage(beat);
+        getOutput(EOC_OUTPUT).setVoltage(eoc);
+}
+
+void RareBreeds_Orbits_Eugene::publish()
+{
+        OrbitsExpanderMessage *message = m_publisher.begin(this);
+        if(message)
+        {
+                message->channels = 1;
+                message->channel[0] = m_published;
+                m_publisher.end(this);
+        }
 }
 
 json_t *RareBreeds_Orbits_Eugene::dataToJson()
@@ -209,6 +516,13 @@ json_t *RareBreeds_Orbits_Eugene::dataToJson()
         {
                 json_object_set_new(root, "beat", m_beat.dataToJson());
                 json_object_set_new(root, "eoc", m_eoc.dataToJson());
+                json_object_set_new(root, "swing", m_swing.dataToJson());
+                json_object_set_new(root, "accent", m_accent.dataToJson());
+                json_object_set_new(root, "bus", m_bus.dataToJson());
+                json_object_set_new(root, "song", m_song.dataToJson());
+                json_object_set_new(root, "audio_rate", json_boolean(m_audio_rate));
+                json_object_set_new(root, "precision", json_boolean(m_precision));
+                json_object_set_new(root, "internal_clock", json_boolean(m_internal_clock));
                 json_object_set_new(root, "randomization_mask", json_integer(m_randomization_mask));
 
                 if(m_widget)
@@ -229,6 +543,28 @@ void RareBreeds_Orbits_Eugene::dataFromJson(json_t *root)
         {
                 m_beat.dataFromJson(json_object_get(root, "beat"));
                 m_eoc.dataFromJson(json_object_get(root, "eoc"));
+                m_swing.dataFromJson(json_object_get(root, "swing"));
+                m_accent.dataFromJson(json_object_get(root, "accent"));
+                m_bus.dataFromJson(json_object_get(root, "bus"));
+                m_song.dataFromJson(json_object_get(root, "song"));
+
+                json_t *audio_rate = json_object_get(root, "audio_rate");
+                if(audio_rate)
+                {
+                        m_audio_rate = json_boolean_value(audio_rate);
+                }
+
+                json_t *precision = json_object_get(root, "precision");
+                if(precision)
+                {
+                        m_precision = json_boolean_value(precision);
+                }
+
+                json_t *internal_clock = json_object_get(root, "internal_clock");
+                if(internal_clock)
+                {
+                        m_internal_clock = json_boolean_value(internal_clock);
+                }
                 m_randomization_mask = RANDOMIZE_ALL;
                 json_load_integer(root, "randomization_mask", &m_randomization_mask);
 
@@ -249,6 +585,14 @@ void RareBreeds_Orbits_Eugene::dataFromJson(json_t *root)
 void RareBreeds_Orbits_Eugene::onReset()
 {
         m_current_step = 0;
+        m_swing_delay.reset();
+        m_lookahead.reset();
+        m_song.restart();
+        m_accent_level = 0.f;
+        m_audio_rate_pattern = AudioRatePattern();
+        m_master_clock.reset();
+        m_ratio_clock.reset();
+        m_published.cycles = 0;
 }
 
 RareBreeds_Orbits_Eugene::~RareBreeds_Orbits_Eugene()
@@ -259,49 +603,51 @@ RareBreeds_Orbits_Eugene::~RareBreeds_Orbits_Eugene()
 void RareBreeds_Orbits_Eugene::onRandomize(const RandomizeEvent& e)
 {
         (void) e;
+        ORBITS_PROFILE_ADD(m_profile, RANDOMIZATIONS, 1);
+        ORBITS_TRACE(m_trace, RANDOMIZE, APP->engine->getFrame(), 0, m_randomization_mask);
 
         if (m_randomization_mask & (1 << RANDOMIZE_LENGTH))
         {
-                float length = random::uniform() * rhythm::max_length;
+                float length = ORBITS_UNIFORM(m_capture) * rhythm::max_length;
                 getParam(LENGTH_KNOB_PARAM).setValue(length);
         }
 
         if (m_randomization_mask & (1 << RANDOMIZE_LENGTH_CV))
         {
-                getParam(LENGTH_CV_KNOB_PARAM).setValue(random::uniform());
+                getParam(LENGTH_CV_KNOB_PARAM).setValue(ORBITS_UNIFORM(m_capture));
         }
 
         if (m_randomization_mask & (1 << RANDOMIZE_HITS))
         {
-                float hits = random::uniform();
+                float hits = ORBITS_UNIFORM(m_capture);
                 getParam(HITS_KNOB_PARAM).setValue(hits);
         }
 
         if (m_randomization_mask & (1 << RANDOMIZE_HITS_CV))
         {
-                getParam(HITS_CV_KNOB_PARAM).setValue(random::uniform());
+                getParam(HITS_CV_KNOB_PARAM).setValue(ORBITS_UNIFORM(m_capture));
         }
 
         if (m_randomization_mask & (1 << RANDOMIZE_SHIFT))
         {
-                float shift = random::uniform() * (rhythm::max_length - 1);
+                float shift = ORBITS_UNIFORM(m_capture) * (rhythm::max_length - 1);
                 getParam(SHIFT_KNOB_PARAM).setValue(shift);
         }
 
         if (m_randomization_mask & (1 << RANDOMIZE_SHIFT_CV))
         {
-                getParam(SHIFT_CV_KNOB_PARAM).setValue(random::uniform());
+                getParam(SHIFT_CV_KNOB_PARAM).setValue(ORBITS_UNIFORM(m_capture));
         }
 
         if (m_randomization_mask & (1 << RANDOMIZE_REVERSE))
         {
-                bool reverse = (random::uniform() < 0.5f);
+                bool reverse = (ORBITS_UNIFORM(m_capture) < 0.5f);
                 getParam(REVERSE_KNOB_PARAM).setValue(reverse);
         }
 
         if (m_randomization_mask & (1 << RANDOMIZE_INVERT))
         {
-                bool invert = (random::uniform() < 0.5f);
+                bool invert = (ORBITS_UNIFORM(m_capture) < 0.5f);
                 getParam(INVERT_KNOB_PARAM).setValue(invert);
         }
 }
@@ -1,6 +1,12 @@
 #pragma once
 
+#include "ExpanderModule.hpp"
+#include "OrbitsBus.hpp"
+#include "OrbitsCapture.hpp"
+#include "OrbitsExpanderMessage.hpp"
 #include "OrbitsModule.hpp"
+#include "OrbitsPresets.hpp"
+#include "OrbitsProfile.hpp"
 #include "Rhythm.hpp"
 
 #include <atomic>
@@ -11,11 +17,14 @@ struct EugeneDisplayData
 {
         unsigned int length, hits, shift, current_step;
         bool reverse, invert;
+        // The pattern drawn, which differs from length, hits and shift while morphing
+        uint32_t pattern;
 
         bool operator==(const EugeneDisplayData &rhs) const
         {
                 return length == rhs.length && hits == rhs.hits && shift == rhs.shift &&
-                       current_step == rhs.current_step && reverse == rhs.reverse && invert == rhs.invert;
+                       current_step == rhs.current_step && reverse == rhs.reverse && invert == rhs.invert &&
+                       pattern == rhs.pattern;
         }
 
         bool operator!=(const EugeneDisplayData &rhs) const
@@ -38,6 +47,9 @@ struct RareBreeds_Orbits_Eugene : Module
                 INVERT_KNOB_PARAM,
                 RANDOM_KNOB_PARAM,
                 SYNC_KNOB_PARAM,
+                SWING_PARAM,
+                MORPH_PARAM,
+                TEMPO_PARAM,
                 NUM_PARAMS
         };
         enum InputIds
@@ -88,6 +100,50 @@ struct RareBreeds_Orbits_Eugene : Module
         EOCMode m_eoc;
         EOCGenerator m_eoc_generator;
 
+        SwingMode m_swing;
+        SwingDelay m_swing_delay;
+
+        PatternCache m_pattern;
+        MorphCache m_morph;
+        AnalysisCache m_analysis;
+
+        AccentMode m_accent;
+        AccentTable m_accent_table;
+        float m_accent_level = 0.f;
+        Lookahead m_lookahead;
+
+        OrbitsBusClient m_bus;
+
+        Song m_song;
+
+        bool m_audio_rate = false;
+        AudioRatePattern m_audio_rate_pattern;
+
+        bool m_internal_clock = false;
+        MasterClock m_master_clock;
+        RatioClock m_ratio_clock;
+
+        // Band limited outputs with the steps placed where the clock crossed the threshold
+        bool m_precision = false;
+        PrecisionOutputs<4> m_precision_outputs;
+        float m_clock_voltage = 0.f;
+        float m_edge_position = 0.f;
+
+#ifdef ORBITS_PROFILE
+        OrbitsProfile m_profile;
+        OrbitsTrace m_trace;
+        OrbitsCapture m_capture;
+        dsp::BooleanTrigger m_trace_beat;
+        dsp::BooleanTrigger m_trace_eoc;
+#endif
+
+        OrbitsExpanderLink m_expander;
+        OrbitsExpanderPublisher m_publisher;
+        OrbitsPresetCV m_preset;
+        // What the display draws, published by the engine
+        DisplayWatch<EugeneDisplayData> m_display;
+        OrbitsExpanderChannel m_published = {};
+
         unsigned int m_current_step = 0;
         int m_randomization_mask = RANDOMIZE_ALL;
 
@@ -101,11 +157,25 @@ struct RareBreeds_Orbits_Eugene : Module
         unsigned int readShift(unsigned int length);
         bool readReverse();
         bool readInvert();
+        // The settings as last read, without processing the CV triggers
+        bool isReversed();
+        bool isInverted();
+        float readSwingOffset();
+        bool isMorphing();
+        float readMorph();
+        void publish();
         void process(const ProcessArgs &args) override;
+        void processBypass(const ProcessArgs &args) override;
+        void processAudioRate(float clock, bool sync);
+        void writeOutputs(float beat, float eoc);
+        float readTempo();
+        void processPreset();
         json_t *dataToJson() override;
         void dataFromJson(json_t *root) override;
         void onReset() override;
+        // Engine thread, the data the display should draw
         EugeneDisplayData getDisplayData(void);
+        // UI thread, the latest published data or the module browser's
         static EugeneDisplayData getDisplayData(RareBreeds_Orbits_Eugene *module);
         void onRandomize(const RandomizeEvent& e) override;
 };
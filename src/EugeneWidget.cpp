@@ -3,13 +3,81 @@
 #include "OrbitsConfig.hpp"
 #include "OrbitsSkinned.hpp"
 
+#include <algorithm>
+#include <cmath>
+
 static OrbitsConfig g_config("res/eugene-layout.json");
 
+// Hits and length in the middle of the rhythm, only drawn again when they change
+struct EugeneRhythmText : Widget
+{
+        unsigned int m_hits = 0;
+        unsigned int m_length = 0;
+        EugeneRhythmText(Vec size);
+        void draw(const DrawArgs &args) override;
+};
+
+EugeneRhythmText::EugeneRhythmText(Vec size)
+{
+        box.pos = Vec(0.0, 0.0);
+        box.size = size;
+}
+
+void EugeneRhythmText::draw(const DrawArgs &args)
+{
+        // Draw length text center bottom and hits text center top
+        nvgFillColor(args.vg, color::WHITE);
+        nvgTextAlign(args.vg, NVG_ALIGN_CENTER | NVG_ALIGN_MIDDLE);
+        nvgFontSize(args.vg, 20);
+        std::shared_ptr<Font> font = APP->window->loadFont(orbitsDisplayFont());
+        nvgFontFaceId(args.vg, font->handle);
+        nvgText(args.vg, box.size.x / 2.f, box.size.y / 2.f - 7.f, orbitsNumberText(m_hits), NULL);
+        nvgText(args.vg, box.size.x / 2.f, box.size.y / 2.f + 7.f, orbitsNumberText(m_length), NULL);
+}
+
+// Where each step of a rhythm is drawn, for every length
+struct EugeneStep
+{
+        // Centre of the step's circle, on the inner ring for every other step of long rhythms
+        float x, y;
+        // Rotation of the step from the top of the display
+        float cos, sin;
+};
+
+static const EugeneStep *eugeneSteps(unsigned int length)
+{
+        static const struct Table
+        {
+                EugeneStep steps[rhythm::max_length + 1][rhythm::max_length];
+
+                Table()
+                {
+                        // Placement of the inner ring of circles when there's too many of them for one ring
+                        const float inner_ring_scale = 0.75f;
+
+                        for(unsigned int length = 1; length <= rhythm::max_length; ++length)
+                        {
+                                for(unsigned int k = 0; k < length; ++k)
+                                {
+                                        const float angle = 2.f * k * (float)M_PI / length;
+                                        const float y_pos = (length > 16 && k % 2) ? inner_ring_scale : 1.f;
+                                        EugeneStep &step = steps[length][k];
+                                        step.cos = std::cos(angle);
+                                        step.sin = std::sin(angle);
+                                        step.x = -y_pos * step.sin;
+                                        step.y = y_pos * step.cos;
+                                }
+                        }
+                }
+        } table;
+        return table.steps[length];
+}
+
 struct EugeneRhythmDisplayUnbuffered : Widget
 {
         EugeneDisplayData m_data;
         EugeneRhythmDisplayUnbuffered(Vec size);
-        void drawLayer(const DrawArgs &args, int layer) override;
+        void draw(const DrawArgs &args) override;
 };
 
 EugeneRhythmDisplayUnbuffered::EugeneRhythmDisplayUnbuffered(Vec size)
@@ -18,154 +86,166 @@ EugeneRhythmDisplayUnbuffered::EugeneRhythmDisplayUnbuffered(Vec size)
         box.size = size;
 }
 
-void EugeneRhythmDisplayUnbuffered::drawLayer(const DrawArgs &args, int layer)
+void EugeneRhythmDisplayUnbuffered::draw(const DrawArgs &args)
 {
-        // Drawings to layer 1 don't dim when the room lights are dimmed
-        if(layer == 1)
-        {
-                const auto foreground_color = color::WHITE;
+        const auto foreground_color = color::WHITE;
 
-                nvgSave(args.vg);
+        nvgSave(args.vg);
 
-                const Rect b = Rect(Vec(0, 0), box.size);
-                nvgScissor(args.vg, b.pos.x, b.pos.y, b.size.x, b.size.y);
+        const Rect b = Rect(Vec(0, 0), box.size);
+        nvgScissor(args.vg, b.pos.x, b.pos.y, b.size.x, b.size.y);
 
-                // Everything drawn after here is in the foreground colour
-                nvgStrokeColor(args.vg, foreground_color);
-                nvgFillColor(args.vg, foreground_color);
+        // Everything drawn after here is in the foreground colour
+        nvgStrokeColor(args.vg, foreground_color);
+        nvgFillColor(args.vg, foreground_color);
 
-                // Translate so (0, 0) is the center of the screen
-                nvgTranslate(args.vg, b.size.x / 2.f, b.size.y / 2.f);
-
-                // Draw length text center bottom and hits text center top
-                nvgBeginPath(args.vg);
-                nvgTextAlign(args.vg, NVG_ALIGN_CENTER | NVG_ALIGN_MIDDLE);
-                nvgFontSize(args.vg, 20);
-                std::shared_ptr<Font> font = APP->window->loadFont(asset::plugin(pluginInstance, "res/fonts/ShareTechMono-Regular.ttf"));
-                nvgFontFaceId(args.vg, font->handle);
-                nvgText(args.vg, 0.f, -7.f, std::to_string(m_data.hits).c_str(), NULL);
-                nvgText(args.vg, 0.f, 7.f, std::to_string(m_data.length).c_str(), NULL);
-                // nvgFill(args.vg);
-
-                // Scale to [-1, 1]
-                nvgScale(args.vg, b.size.x / 2.f, b.size.y / 2.f);
-
-                // Flip x and y so we start at the top and positive angle increments go clockwise
-                nvgScale(args.vg, -1.f, -1.f);
-
-                // nvgBeginPath(args.vg);
-                if(m_data.reverse)
-                {
-                        nvgMoveTo(args.vg, 0.23f, -0.2f);
-                        nvgLineTo(args.vg, 0.3f, 0.f);
-                        nvgLineTo(args.vg, 0.23f, 0.2f);
-                }
-                else
-                {
-                        nvgMoveTo(args.vg, -0.23f, 0.2f);
-                        nvgLineTo(args.vg, -0.3f, -0.f);
-                        nvgLineTo(args.vg, -0.23f, -0.2f);
-                }
-                nvgFill(args.vg);
+        // Translate so (0, 0) is the center of the screen
+        nvgTranslate(args.vg, b.size.x / 2.f, b.size.y / 2.f);
 
-                // set the on beat radius so 8 can fit on the screen
-                const auto on_radius = 1.f / 8.f;
+        // Scale to [-1, 1]
+        nvgScale(args.vg, b.size.x / 2.f, b.size.y / 2.f);
 
-                // set outline radius so it's bigger than the on_radius
-                const auto outline_radius = on_radius * 1.3f;
+        // Flip x and y so we start at the top and positive angle increments go clockwise
+        nvgScale(args.vg, -1.f, -1.f);
 
-                // set the off beat radius so it's almost a dot
-                const auto off_radius = on_radius / 10.f;
+        nvgBeginPath(args.vg);
+        if(m_data.reverse)
+        {
+                nvgMoveTo(args.vg, 0.23f, -0.2f);
+                nvgLineTo(args.vg, 0.3f, 0.f);
+                nvgLineTo(args.vg, 0.23f, 0.2f);
+        }
+        else
+        {
+                nvgMoveTo(args.vg, -0.23f, 0.2f);
+                nvgLineTo(args.vg, -0.3f, -0.f);
+                nvgLineTo(args.vg, -0.23f, -0.2f);
+        }
+        nvgFill(args.vg);
 
-                // Placement of the inner ring of circles when there's too many of them for one ring
-                const auto inner_ring_scale = 0.75f;
+        // set the on beat radius so 8 can fit on the screen
+        const auto on_radius = 1.f / 8.f;
 
-                // Width of the line when drawing circles
-                const auto circle_stroke_width = 0.03f;
-                nvgStrokeWidth(args.vg, circle_stroke_width);
+        // set outline radius so it's bigger than the on_radius
+        const auto outline_radius = on_radius * 1.3f;
 
-                // Add a border of half a circle so we don't draw over the edge
-                nvgScale(args.vg, 1.f - outline_radius, 1.f - outline_radius);
+        // set the off beat radius so it's almost a dot
+        const auto off_radius = on_radius / 10.f;
 
-                for(unsigned int k = 0; k < m_data.length; ++k)
-                {
-                        float y_pos = 1.f;
-                        if(m_data.length > 16 and k % 2)
-                        {
-                                y_pos = inner_ring_scale;
-                        }
+        // Width of the line when drawing circles
+        const auto circle_stroke_width = 0.03f;
+        nvgStrokeWidth(args.vg, circle_stroke_width);
 
-                        float radius = off_radius;
+        // Add a border of half a circle so we don't draw over the edge
+        nvgScale(args.vg, 1.f - outline_radius, 1.f - outline_radius);
 
-                        if(rhythm::beat(m_data.length, m_data.hits, m_data.shift, k, m_data.invert))
-                        {
-                                radius = on_radius;
-                        }
+        const unsigned int length = std::min(m_data.length, rhythm::max_length);
+        const EugeneStep *steps = eugeneSteps(length);
 
-                        nvgSave(args.vg);
-                        nvgRotate(args.vg, 2.f * k * (float)M_PI / m_data.length);
-                        nvgBeginPath(args.vg);
-                        nvgCircle(args.vg, 0.f, y_pos, radius);
-                        if(m_data.invert)
-                        {
-                                nvgStroke(args.vg);
-                        }
-                        else
-                        {
-                                nvgFill(args.vg);
-                        }
+        // Every beat in one path, they're all filled or all outlined
+        nvgBeginPath(args.vg);
+        for(unsigned int k = 0; k < length; ++k)
+        {
+                float radius = off_radius;
 
-                        // Current beat marker
-                        // Highlight the beat that has just played
-                        // For forward moving rhythms this is the previous index
-                        // For reversed rhythms this is index
-                        if((m_data.reverse && m_data.current_step == k) ||
-                        (!m_data.reverse &&
-                        ((k == m_data.length - 1) ? (0 == m_data.current_step) : (k + 1 == m_data.current_step))))
-                        {
-                                nvgBeginPath(args.vg);
-                                nvgCircle(args.vg, 0.f, y_pos, outline_radius);
-                                nvgStroke(args.vg);
-                        }
+                if((m_data.pattern >> k) & 1)
+                {
+                        radius = on_radius;
+                }
 
-                        // shift pointer
-                        if(m_data.shift == k)
-                        {
-                                nvgBeginPath(args.vg);
-                                nvgMoveTo(args.vg, 0.f, 0.5f);
-                                nvgLineTo(args.vg, -0.05f, 0.4f);
-                                nvgLineTo(args.vg, 0.05f, 0.4f);
-                                nvgClosePath(args.vg);
-                                nvgFill(args.vg);
-                        }
+                nvgCircle(args.vg, steps[k].x, steps[k].y, radius);
+        }
+        if(m_data.invert)
+        {
+                nvgStroke(args.vg);
+        }
+        else
+        {
+                nvgFill(args.vg);
+        }
 
-                        nvgRestore(args.vg);
+        if(length)
+        {
+                // Current beat marker
+                // Highlight the beat that has just played
+                // For forward moving rhythms this is the previous index
+                // For reversed rhythms this is index
+                unsigned int current = m_data.current_step;
+                if(!m_data.reverse)
+                {
+                        current = (current == 0) ? length - 1 : current - 1;
+                }
+                if(current < length)
+                {
+                        nvgBeginPath(args.vg);
+                        nvgCircle(args.vg, steps[current].x, steps[current].y, outline_radius);
+                        nvgStroke(args.vg);
                 }
+        }
 
-                nvgResetScissor(args.vg);
-                nvgRestore(args.vg);
+        // shift pointer
+        if(m_data.shift < length)
+        {
+                const EugeneStep &step = steps[m_data.shift];
+                nvgBeginPath(args.vg);
+                nvgMoveTo(args.vg, -0.5f * step.sin, 0.5f * step.cos);
+                nvgLineTo(args.vg, -0.05f * step.cos - 0.4f * step.sin, -0.05f * step.sin + 0.4f * step.cos);
+                nvgLineTo(args.vg, 0.05f * step.cos - 0.4f * step.sin, 0.05f * step.sin + 0.4f * step.cos);
+                nvgClosePath(args.vg);
+                nvgFill(args.vg);
         }
+
+        nvgResetScissor(args.vg);
+        nvgRestore(args.vg);
 }
 
+// The rhythm and its text are cached separately, most changes only move the current beat
 struct EugeneRhythmDisplay : Widget
 {
-        FramebufferWidget *m_fb;
+        OrbitsDisplayBuffer *m_fb;
         EugeneRhythmDisplayUnbuffered *m_ub;
+        OrbitsDisplayBuffer *m_text_fb;
+        EugeneRhythmText *m_text;
         RareBreeds_Orbits_Eugene *m_module;
+        OrbitsDisplayRefresh m_refresh;
 
-        EugeneRhythmDisplay(RareBreeds_Orbits_Eugene *module, Vec pos, Vec size);
+        EugeneRhythmDisplay(RareBreeds_Orbits_Eugene *module, const OrbitsDisplayRate *rate, Vec pos, Vec size);
         void drawLayer(const DrawArgs& args, int layer) override;
+        // Reads the module and marks the parts of the display that changed
+        void readModule(void);
 };
 
-EugeneRhythmDisplay::EugeneRhythmDisplay(RareBreeds_Orbits_Eugene *module, Vec pos, Vec size)
+EugeneRhythmDisplay::EugeneRhythmDisplay(RareBreeds_Orbits_Eugene *module, const OrbitsDisplayRate *rate, Vec pos,
+                                         Vec size)
 {
         m_module = module;
+        m_refresh.m_rate = rate;
         box.pos = pos;
         box.size = size;
-        m_fb = new FramebufferWidget;
+        m_fb = new OrbitsDisplayBuffer(size);
         addChild(m_fb);
         m_ub = new EugeneRhythmDisplayUnbuffered(size);
         m_fb->addChild(m_ub);
+        m_text_fb = new OrbitsDisplayBuffer(size);
+        addChild(m_text_fb);
+        m_text = new EugeneRhythmText(size);
+        m_text_fb->addChild(m_text);
+}
+
+void EugeneRhythmDisplay::readModule(void)
+{
+        EugeneDisplayData data = RareBreeds_Orbits_Eugene::getDisplayData(m_module);
+        if(data != m_ub->m_data)
+        {
+                m_ub->m_data = data;
+                m_fb->dirty = true;
+        }
+        if(data.hits != m_text->m_hits || data.length != m_text->m_length)
+        {
+                m_text->m_hits = data.hits;
+                m_text->m_length = data.length;
+                m_text_fb->dirty = true;
+        }
 }
 
 void EugeneRhythmDisplay::drawLayer(const DrawArgs &args, int layer)
@@ -175,11 +255,11 @@ void EugeneRhythmDisplay::drawLayer(const DrawArgs &args, int layer)
         {
                 nvgGlobalTint(args.vg, color::WHITE);
 
-                EugeneDisplayData data = RareBreeds_Orbits_Eugene::getDisplayData(m_module);
-                if(data != m_ub->m_data)
+                // The module browser's display never changes
+                uint32_t generation = m_module ? m_module->m_display.getGeneration() : 1;
+                if(m_refresh.update(generation))
                 {
-                        m_ub->m_data = data;
-                        m_fb->dirty = true;
+                        readModule();
                 }
         }
 
@@ -196,6 +276,24 @@ RareBreeds_Orbits_EugeneWidget::RareBreeds_Orbits_EugeneWidget(RareBreeds_Orbits
                 module->m_widget = this;
                 beat_widget.m_module = &module->m_beat;
                 eoc_widget.m_module = &module->m_eoc;
+                swing_widget.m_module = &module->m_swing;
+                swing_widget.m_quantity = module->getParamQuantity(RareBreeds_Orbits_Eugene::SWING_PARAM);
+                morph_widget.m_quantity = module->getParamQuantity(RareBreeds_Orbits_Eugene::MORPH_PARAM);
+                clock_widget.m_enabled = &module->m_internal_clock;
+                clock_widget.m_tempo = module->getParamQuantity(RareBreeds_Orbits_Eugene::TEMPO_PARAM);
+                accent_widget.m_module = &module->m_accent;
+                bus_widget.m_module = &module->m_bus;
+                preset_widget.m_module = module;
+                preset_widget.m_cv = &module->m_preset;
+                preset_widget.refresh();
+#ifdef ORBITS_PROFILE
+                diagnostics_widget.m_profile = &module->m_profile;
+                diagnostics_widget.m_trace = &module->m_trace;
+                diagnostics_widget.m_capture = [](Module *module) {
+                        return &static_cast<RareBreeds_Orbits_Eugene *>(module)->m_capture;
+                };
+                diagnostics_widget.m_module = module;
+#endif
         }
 
         m_theme = m_config->getDefaultThemeId();
@@ -231,7 +329,8 @@ RareBreeds_Orbits_EugeneWidget::RareBreeds_Orbits_EugeneWidget(RareBreeds_Orbits
         addOutput(createOrbitsSkinnedOutput(m_config, "eoc_port", module, RareBreeds_Orbits_Eugene::EOC_OUTPUT));
         // clang-format on
 
-        rhythm_display = new EugeneRhythmDisplay(module, m_config->getPos("display"), m_config->getSize("display"));
+        rhythm_display = new EugeneRhythmDisplay(module, &m_display_rate, m_config->getPos("display"),
+                                         m_config->getSize("display"));
         addChild(rhythm_display);
 }
 
@@ -239,8 +338,70 @@ void RareBreeds_Orbits_EugeneWidget::appendModuleContextMenu(Menu *menu)
 {
         beat_widget.appendContextMenu(menu);
         eoc_widget.appendContextMenu(menu);
+        swing_widget.appendContextMenu(menu);
+        morph_widget.appendContextMenu(menu);
+        accent_widget.appendContextMenu(menu);
+        clock_widget.appendContextMenu(menu);
+        bus_widget.appendContextMenu(menu);
+        preset_widget.appendContextMenu(menu);
+#ifdef ORBITS_PROFILE
+        diagnostics_widget.appendContextMenu(menu);
+#endif
 
         RareBreeds_Orbits_Eugene *eugene = static_cast<RareBreeds_Orbits_Eugene *>(module);
+        menu->addChild(createBoolPtrMenuItem("Audio rate mode", "", &eugene->m_audio_rate));
+        menu->addChild(createBoolPtrMenuItem("Precision outputs", "", &eugene->m_precision));
+
+        Song *song = &eugene->m_song;
+        menu->addChild(createSubmenuItem("Song", "",
+                [=](Menu* menu) {
+                        menu->addChild(createCheckMenuItem("Play song", "",
+                                [=]() {return song->m_enabled.load();},
+                                [=]() {song->m_enabled = !song->m_enabled; song->requestRestart();}
+                        ));
+
+                        menu->addChild(createMenuItem("Add current settings", "", [=]() {
+                                SongEntry entry;
+                                entry.length = eugene->readLength();
+                                entry.hits = eugene->readHits(entry.length);
+                                entry.shift = eugene->readShift(entry.length);
+                                entry.variation = 0;
+                                entry.reverse = eugene->isReversed();
+                                entry.invert = eugene->isInverted();
+                                entry.repeats = 1;
+                                song->add(entry);
+                        }, song->m_size == Song::max_entries));
+
+                        menu->addChild(createMenuItem("Clear", "", [=]() {song->clear();}, song->m_size == 0));
+
+                        if(song->m_size)
+                        {
+                                menu->addChild(new MenuSeparator);
+                        }
+
+                        for(int i = 0; i < song->m_size; ++i)
+                        {
+                                const SongEntry &entry = song->m_entries[i];
+                                std::string label = string::f("%d: %d/%d +%d%s%s", i + 1, entry.hits, entry.length,
+                                                              entry.shift, entry.reverse ? " rev" : "",
+                                                              entry.invert ? " inv" : "");
+                                std::string repeats = string::f("x%d", entry.repeats);
+                                menu->addChild(createSubmenuItem(label, repeats, [=](Menu* menu) {
+                                        menu->addChild(createIndexSubmenuItem("Repeats",
+                                                {"1", "2", "3", "4", "5", "6", "7", "8",
+                                                 "9", "10", "11", "12", "13", "14", "15", "16"},
+                                                [=]() {return song->m_entries[i].repeats - 1;},
+                                                [=](size_t index) {
+                                                        song->m_entries[i].repeats = index + 1;
+                                                        song->compile();
+                                                }
+                                        ));
+                                        menu->addChild(createMenuItem("Delete", "", [=]() {song->remove(i);}));
+                                }));
+                        }
+                }
+        ));
+
 	menu->addChild(createSubmenuItem("Randomize Filter", "",
                 [=](Menu* menu) {
                         menu->addChild(createMenuLabel("Parameters that are randomized"));
@@ -9,6 +9,15 @@ struct RareBreeds_Orbits_EugeneWidget : OrbitsWidget
 {
         BeatWidget beat_widget;
         EOCWidget eoc_widget;
+        SwingWidget swing_widget;
+        MorphWidget morph_widget;
+        ClockWidget clock_widget;
+#ifdef ORBITS_PROFILE
+        DiagnosticsWidget diagnostics_widget;
+#endif
+        AccentWidget accent_widget;
+        BusWidget bus_widget;
+        PresetWidget preset_widget;
         EugeneRhythmDisplay *rhythm_display;
         RareBreeds_Orbits_EugeneWidget(RareBreeds_Orbits_Eugene *module);
         void appendModuleContextMenu(Menu *menu) override;
@@ -0,0 +1,5 @@
+#include "ExpanderModule.hpp"
+#include "ExpanderWidget.hpp"
+
+Model *modelRareBreeds_Orbits_Expander =
+        createModel<RareBreeds_Orbits_Expander, RareBreeds_Orbits_ExpanderWidget>("RareBreeds_Orbits_Expander");
@@ -0,0 +1,127 @@
+#include "ExpanderModule.hpp"
+#include "Rhythm.hpp"
+
+RareBreeds_Orbits_Expander::RareBreeds_Orbits_Expander()
+{
+        config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
+
+        configInput(SWING_CV_INPUT, "Swing CV");
+        configInput(SCENE_CV_INPUT, "Polygene scene CV");
+        configInput(MORPH_CV_INPUT, "Morph CV");
+        configInput(TEMPO_CV_INPUT, "Internal clock tempo CV");
+        configInput(PRESET_CV_INPUT, "Preset CV");
+
+        configOutput(NEXT_OUTPUT, "Steps to next beat");
+        configOutput(RAMP_OUTPUT, "Ramp to next beat");
+        configOutput(EVEN_OUTPUT, "Evenness");
+        configOutput(OFF_BEAT_OUTPUT, "Off-beatness");
+        configOutput(DENSITY_OUTPUT, "Density");
+        configOutput(ODD_OUTPUT, "Rhythmic oddity");
+        configOutput(ACCENT_OUTPUT, "Accent");
+
+        leftExpander.producerMessage = &m_messages[0];
+        leftExpander.consumerMessage = &m_messages[1];
+}
+
+void RareBreeds_Orbits_Expander::process(const ProcessArgs &args)
+{
+        Module *host = getHost();
+        if(host)
+        {
+                auto message = static_cast<InputMessage *>(host->rightExpander.producerMessage);
+                for(int i = 0; i < NUM_INPUTS; ++i)
+                {
+                        Input &input = getInput(i);
+                        message->channels[i] = input.getChannels();
+                        for(int c = 0; c < PORT_MAX_CHANNELS; ++c)
+                        {
+                                message->voltages[i][c] = input.getVoltage(c);
+                        }
+                }
+                host->rightExpander.messageFlipRequested = true;
+        }
+
+        // The message is left alone once the host is removed, don't keep outputting it
+        auto message = static_cast<const OutputMessage *>(leftExpander.consumerMessage);
+        int channels = host ? message->channels : 0;
+        for(int o = 0; o < NUM_OUTPUTS; ++o)
+        {
+                getOutput(o).setChannels(channels);
+                getOutput(o).writeVoltages(message->voltages[o]);
+        }
+}
+
+RareBreeds_Orbits_Expander *RareBreeds_Orbits_Expander::getExpander(Module *module)
+{
+        // Polygene banks may sit between the module and the expander
+        Module *right = module->rightExpander.module;
+        while(right && right->model == modelRareBreeds_Orbits_PolygeneBank)
+        {
+                right = right->rightExpander.module;
+        }
+
+        if(right && right->model == modelRareBreeds_Orbits_Expander)
+        {
+                return static_cast<RareBreeds_Orbits_Expander *>(right);
+        }
+        return NULL;
+}
+
+Module *RareBreeds_Orbits_Expander::getHost(void)
+{
+        Module *left = leftExpander.module;
+        while(left && left->model == modelRareBreeds_Orbits_PolygeneBank)
+        {
+                left = left->leftExpander.module;
+        }
+
+        if(left && (left->model == modelRareBreeds_Orbits_Eugene || left->model == modelRareBreeds_Orbits_Polygene))
+        {
+                return left;
+        }
+        return NULL;
+}
+
+void OrbitsExpanderLink::init(Module *host)
+{
+        host->rightExpander.producerMessage = &m_messages[0];
+        host->rightExpander.consumerMessage = &m_messages[1];
+}
+
+void OrbitsExpanderLink::process(Module *host)
+{
+        RareBreeds_Orbits_Expander *expander = RareBreeds_Orbits_Expander::getExpander(host);
+        if(!expander)
+        {
+                m_inputs = NULL;
+                m_outputs = NULL;
+                return;
+        }
+
+        // Anything not set this sample keeps its value from the last one
+        m_inputs = static_cast<const RareBreeds_Orbits_Expander::InputMessage *>(host->rightExpander.consumerMessage);
+        m_outputs = static_cast<RareBreeds_Orbits_Expander::OutputMessage *>(expander->leftExpander.producerMessage);
+        *m_outputs = *static_cast<const RareBreeds_Orbits_Expander::OutputMessage *>(
+                expander->leftExpander.consumerMessage);
+        expander->leftExpander.messageFlipRequested = true;
+}
+
+void OrbitsExpanderLink::setNextBeat(int channel, unsigned int steps, float ramp)
+{
+        // 10V is the longest possible distance
+        m_outputs->voltages[RareBreeds_Orbits_Expander::NEXT_OUTPUT][channel] = steps * 10.f / rhythm::max_length;
+        m_outputs->voltages[RareBreeds_Orbits_Expander::RAMP_OUTPUT][channel] = ramp * 10.f;
+}
+
+void OrbitsExpanderLink::setAnalysis(int channel, float evenness, float off_beatness, float density, bool odd)
+{
+        m_outputs->voltages[RareBreeds_Orbits_Expander::EVEN_OUTPUT][channel] = evenness * 10.f;
+        m_outputs->voltages[RareBreeds_Orbits_Expander::OFF_BEAT_OUTPUT][channel] = off_beatness * 10.f;
+        m_outputs->voltages[RareBreeds_Orbits_Expander::DENSITY_OUTPUT][channel] = density * 10.f;
+        m_outputs->voltages[RareBreeds_Orbits_Expander::ODD_OUTPUT][channel] = odd ? 10.f : 0.f;
+}
+
+void OrbitsExpanderLink::setAccent(int channel, float level)
+{
+        m_outputs->voltages[RareBreeds_Orbits_Expander::ACCENT_OUTPUT][channel] = level * 10.f;
+}
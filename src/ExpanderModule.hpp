@@ -0,0 +1,112 @@
+#pragma once
+
+#include "plugin.hpp"
+
+// Adds extra inputs and outputs to the Eugene or Polygene module on its left,
+// Polygene Banks may sit in between.
+//
+// The modules only talk through expander messages, each owned by the module
+// receiving it. Every sample the expander sends its inputs to the host's
+// rightExpander and the host sends the outputs to the expander's leftExpander.
+// Rack flips both at the end of the sample, so each side reads what the other
+// wrote one sample earlier and neither touches the other's ports.
+struct RareBreeds_Orbits_Expander : Module
+{
+        enum ParamIds
+        {
+                NUM_PARAMS
+        };
+        enum InputIds
+        {
+                SWING_CV_INPUT,
+                SCENE_CV_INPUT,
+                MORPH_CV_INPUT,
+                TEMPO_CV_INPUT,
+                PRESET_CV_INPUT,
+                NUM_INPUTS
+        };
+        enum OutputIds
+        {
+                NEXT_OUTPUT,
+                RAMP_OUTPUT,
+                EVEN_OUTPUT,
+                OFF_BEAT_OUTPUT,
+                DENSITY_OUTPUT,
+                ODD_OUTPUT,
+                ACCENT_OUTPUT,
+                NUM_OUTPUTS
+        };
+        enum LightIds
+        {
+                NUM_LIGHTS
+        };
+
+        // Sent from the expander to the host
+        struct InputMessage
+        {
+                // 0 for an input that isn't connected
+                int channels[NUM_INPUTS];
+                float voltages[NUM_INPUTS][PORT_MAX_CHANNELS];
+        };
+
+        // Sent from the host to the expander
+        struct OutputMessage
+        {
+                int channels;
+                float voltages[NUM_OUTPUTS][PORT_MAX_CHANNELS];
+        };
+
+        OutputMessage m_messages[2] = {};
+
+        RareBreeds_Orbits_Expander();
+        void process(const ProcessArgs &args) override;
+
+        // Returns the expander attached to the right of module, or NULL if there isn't one
+        static RareBreeds_Orbits_Expander *getExpander(Module *module);
+        // Returns the Eugene or Polygene attached to the left of the expander, or NULL if there isn't one
+        Module *getHost(void);
+};
+
+// The host's end of the expander messages, held by Eugene and Polygene
+struct OrbitsExpanderLink
+{
+        RareBreeds_Orbits_Expander::InputMessage m_messages[2] = {};
+        const RareBreeds_Orbits_Expander::InputMessage *m_inputs = NULL;
+        RareBreeds_Orbits_Expander::OutputMessage *m_outputs = NULL;
+
+        void init(Module *host);
+
+        // Called at the start of each sample, finds the expander and the inputs it sent
+        void process(Module *host);
+
+        bool isAttached(void) const
+        {
+                return m_inputs != NULL;
+        }
+
+        // Only called while attached
+        bool isConnected(int input) const
+        {
+                return m_inputs->channels[input] > 0;
+        }
+
+        float getVoltage(int input) const
+        {
+                return m_inputs->voltages[input][0];
+        }
+
+        float getPolyVoltage(int input, int channel) const
+        {
+                // Mono inputs apply to every channel, like Input::getPolyVoltage()
+                return m_inputs->voltages[input][m_inputs->channels[input] == 1 ? 0 : channel];
+        }
+
+        void setChannels(int channels)
+        {
+                m_outputs->channels = channels;
+        }
+
+        void setNextBeat(int channel, unsigned int steps, float ramp);
+        void setAnalysis(int channel, float evenness, float off_beatness, float density, bool odd);
+        void setAccent(int channel, float level);
+};
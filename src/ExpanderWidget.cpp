@@ -0,0 +1,39 @@
+#include "ExpanderWidget.hpp"
+#include "ExpanderModule.hpp"
+#include "OrbitsConfig.hpp"
+#include "OrbitsSkinned.hpp"
+
+static OrbitsConfig g_config("res/expander-layout.json");
+
+RareBreeds_Orbits_ExpanderWidget::RareBreeds_Orbits_ExpanderWidget(RareBreeds_Orbits_Expander *module)
+        : OrbitsWidget(&g_config)
+{
+        setModule(module);
+
+        m_theme = m_config->getDefaultThemeId();
+
+        // clang-format off
+        setPanel(APP->window->loadSvg(m_config->getSvg("panel")));
+
+        addChild(createOrbitsSkinnedScrew(m_config, "screw_top_left", Vec(RACK_GRID_WIDTH + RACK_GRID_WIDTH / 2, RACK_GRID_WIDTH / 2)));
+        addChild(createOrbitsSkinnedScrew(m_config, "screw_bottom_right", Vec(box.size.x - RACK_GRID_WIDTH - RACK_GRID_WIDTH / 2, RACK_GRID_HEIGHT - RACK_GRID_WIDTH / 2)));
+
+        addInput(createOrbitsSkinnedInput(m_config, "swing_cv_port", module, RareBreeds_Orbits_Expander::SWING_CV_INPUT));
+        addInput(createOrbitsSkinnedInput(m_config, "scene_cv_port", module, RareBreeds_Orbits_Expander::SCENE_CV_INPUT));
+        addInput(createOrbitsSkinnedInput(m_config, "morph_cv_port", module, RareBreeds_Orbits_Expander::MORPH_CV_INPUT));
+        addInput(createOrbitsSkinnedInput(m_config, "tempo_cv_port", module, RareBreeds_Orbits_Expander::TEMPO_CV_INPUT));
+        addInput(createOrbitsSkinnedInput(m_config, "preset_cv_port", module, RareBreeds_Orbits_Expander::PRESET_CV_INPUT));
+
+        addOutput(createOrbitsSkinnedOutput(m_config, "next_port", module, RareBreeds_Orbits_Expander::NEXT_OUTPUT));
+        addOutput(createOrbitsSkinnedOutput(m_config, "ramp_port", module, RareBreeds_Orbits_Expander::RAMP_OUTPUT));
+        addOutput(createOrbitsSkinnedOutput(m_config, "even_port", module, RareBreeds_Orbits_Expander::EVEN_OUTPUT));
+        addOutput(createOrbitsSkinnedOutput(m_config, "off_beat_port", module, RareBreeds_Orbits_Expander::OFF_BEAT_OUTPUT));
+        addOutput(createOrbitsSkinnedOutput(m_config, "density_port", module, RareBreeds_Orbits_Expander::DENSITY_OUTPUT));
+        addOutput(createOrbitsSkinnedOutput(m_config, "odd_port", module, RareBreeds_Orbits_Expander::ODD_OUTPUT));
+        addOutput(createOrbitsSkinnedOutput(m_config, "accent_port", module, RareBreeds_Orbits_Expander::ACCENT_OUTPUT));
+        // clang-format on
+}
+
+void RareBreeds_Orbits_ExpanderWidget::appendModuleContextMenu(Menu *menu)
+{
+}
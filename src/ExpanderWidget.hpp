@@ -0,0 +1,11 @@
+#pragma once
+
+#include "OrbitsWidget.hpp"
+
+struct RareBreeds_Orbits_Expander;
+
+struct RareBreeds_Orbits_ExpanderWidget : OrbitsWidget
+{
+        RareBreeds_Orbits_ExpanderWidget(RareBreeds_Orbits_Expander *module);
+        void appendModuleContextMenu(Menu *menu) override;
+};
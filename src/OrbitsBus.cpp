@@ -0,0 +1,143 @@
+#include "OrbitsBus.hpp"
+
+static OrbitsBus g_buses[OrbitsBus::num_buses];
+
+OrbitsBus *OrbitsBus::get(int index)
+{
+        return &g_buses[index];
+}
+
+uint64_t OrbitsBus::latest(void) const
+{
+        return m_slots[m_stamps[1].load() > m_stamps[0].load() ? 1 : 0].load();
+}
+
+OrbitsBusClient::~OrbitsBusClient()
+{
+        setBus(-1);
+}
+
+bool OrbitsBusClient::isLeader(void) const
+{
+        return isConnected() && OrbitsBus::get(m_bus)->m_leader.load() == this;
+}
+
+void OrbitsBusClient::setBus(int bus)
+{
+        bool lead = isLeader();
+        setLeader(false);
+        m_bus = math::clamp(bus, -1, OrbitsBus::num_buses - 1);
+        if(lead)
+        {
+                setLeader(true);
+        }
+}
+
+void OrbitsBusClient::setLeader(bool lead)
+{
+        if(!isConnected())
+        {
+                return;
+        }
+
+        OrbitsBus *bus = OrbitsBus::get(m_bus);
+        if(lead)
+        {
+                // Take over from any previous leader, carrying on from the current count
+                uint64_t slot = bus->latest();
+                m_lead_count = (uint32_t)slot;
+                m_lead_generation = (uint32_t)(slot >> 32);
+                bus->m_leader.store(this);
+        }
+        else
+        {
+                void *expected = this;
+                bus->m_leader.compare_exchange_strong(expected, nullptr);
+        }
+}
+
+void OrbitsBusClient::process(int64_t frame, bool *clock, bool *sync)
+{
+        if(!isConnected())
+        {
+                return;
+        }
+
+        OrbitsBus *bus = OrbitsBus::get(m_bus);
+        if(bus->m_leader.load(std::memory_order_relaxed) == this)
+        {
+                if(*sync)
+                {
+                        ++m_lead_generation;
+                        m_lead_count = 0;
+                }
+
+                if(*clock)
+                {
+                        ++m_lead_count;
+                }
+
+                // Written every frame as the slots alternate
+                uint64_t slot = (uint64_t)m_lead_generation << 32 | m_lead_count;
+                bus->m_slots[frame & 1].store(slot, std::memory_order_relaxed);
+                bus->m_stamps[frame & 1].store(frame + 1, std::memory_order_relaxed);
+        }
+
+        // Without a leader writing every frame the other slot is left over
+        // from an earlier frame, and reading the two in turn would see an edge
+        // on every sample
+        if(bus->m_stamps[(frame - 1) & 1].load(std::memory_order_relaxed) != frame)
+        {
+                *clock = false;
+                *sync = false;
+                return;
+        }
+
+        uint64_t slot = bus->m_slots[(frame - 1) & 1].load(std::memory_order_relaxed);
+        uint32_t count = (uint32_t)slot;
+        uint32_t generation = (uint32_t)(slot >> 32);
+
+        *sync = generation != m_generation;
+        *clock = count != m_count && count != 0;
+        m_count = count;
+        m_generation = generation;
+}
+
+unsigned int OrbitsBusClient::getStep(unsigned int length, bool reverse) const
+{
+        // Going forwards the step is played then incremented, going backwards
+        // it's decremented then played
+        unsigned int played = (m_count - 1) % length;
+        return reverse ? (length - played) % length : played;
+}
+
+json_t *OrbitsBusClient::dataToJson(void)
+{
+        json_t *root = json_object();
+        if(root)
+        {
+                json_object_set_new(root, "index", json_integer(m_bus));
+                json_object_set_new(root, "lead", json_boolean(isLeader()));
+        }
+        return root;
+}
+
+void OrbitsBusClient::dataFromJson(json_t *root)
+{
+        if(root)
+        {
+                json_t *index = json_object_get(root, "index");
+                if(index)
+                {
+                        setBus(json_integer_value(index));
+                }
+
+                // Don't take over an existing leader, duplicating the leader
+                // module shouldn't steal the bus from it
+                json_t *lead = json_object_get(root, "lead");
+                if(lead && json_boolean_value(lead) && isConnected() && !OrbitsBus::get(m_bus)->m_leader.load())
+                {
+                        setLeader(true);
+                }
+        }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "plugin.hpp"
+
+#include <atomic>
+#include <cstdint>
+
+// Lets many modules in the same Rack share one clock without cables.
+//
+// The leader of a bus counts its clock edges and syncs, every module on the
+// bus (the leader included) derives its clock, sync and step from that count.
+// The leader writes the count for frame N into slot N % 2 and everyone reads
+// the slot written on the previous frame, which Rack guarantees is complete,
+// so every module on a bus sees each edge on exactly the same frame.
+//
+// Each slot is stamped with the frame it was written for. A slot not written
+// on the previous frame means the leader has stopped (bypassed, removed or
+// stepped down), and followers ignore the bus until a leader writes again.
+struct OrbitsBus
+{
+        static const int num_buses = 8;
+
+        // Clock edge count in the low 32 bits, sync generation in the high 32 bits
+        std::atomic<uint64_t> m_slots[2];
+        // Frame each slot was written for plus one, 0 if never written
+        std::atomic<int64_t> m_stamps[2];
+        std::atomic<void *> m_leader;
+
+        static OrbitsBus *get(int index);
+
+        // The slot written most recently, where a new leader carries on from
+        uint64_t latest(void) const;
+};
+
+struct OrbitsBusClient
+{
+        // -1 when not on a bus
+        int m_bus = -1;
+
+        // The leader's own count
+        uint32_t m_lead_count = 0;
+        uint32_t m_lead_generation = 0;
+
+        // The count and generation last read from the bus
+        uint32_t m_count = 0;
+        uint32_t m_generation = 0;
+
+        ~OrbitsBusClient();
+
+        bool isConnected(void) const
+        {
+                return m_bus >= 0;
+        }
+
+        bool isLeader(void) const;
+        void setBus(int bus);
+        void setLeader(bool lead);
+
+        // Replaces clock and sync with the bus clock and sync when on a bus.
+        // The leader publishes its own clock and sync first.
+        void process(int64_t frame, bool *clock, bool *sync);
+
+        // The step to start a clock edge from so it plays the step the bus is on
+        unsigned int getStep(unsigned int length, bool reverse) const;
+
+        json_t *dataToJson(void);
+        void dataFromJson(json_t *root);
+};
@@ -0,0 +1,412 @@
+#include "OrbitsCapture.hpp"
+
+#ifdef ORBITS_PROFILE
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static uint32_t floatBits(float value)
+{
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+}
+
+static float bitsFloat(uint32_t bits)
+{
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+}
+
+static void writeVarint(uint8_t *data, size_t *size, uint32_t value)
+{
+        while(value >= 0x80)
+        {
+                data[(*size)++] = (value & 0x7f) | 0x80;
+                value >>= 7;
+        }
+        data[(*size)++] = value;
+}
+
+static bool readVarint(const std::vector<uint8_t> &data, size_t *pos, uint32_t *value)
+{
+        *value = 0;
+        for(int shift = 0; shift < 35; shift += 7)
+        {
+                if(*pos >= data.size())
+                {
+                        return false;
+                }
+                uint8_t byte = data[(*pos)++];
+                *value |= (uint32_t)(byte & 0x7f) << shift;
+                if(!(byte & 0x80))
+                {
+                        return true;
+                }
+        }
+        return false;
+}
+
+void OrbitsCapture::start(Module *module)
+{
+        // The engine only touches the buffers while recording or stopping
+        int state = m_state.load(std::memory_order_acquire);
+        if(state == RECORDING || state == STOPPING || state == REPLAYING)
+        {
+                return;
+        }
+
+        m_params = module->params.size();
+        m_inputs = module->inputs.size();
+        m_outputs = module->outputs.size();
+
+        json_t *root = module->toJson();
+        char *str = json_dumps(root, JSON_COMPACT);
+        m_module_json = str ? str : "";
+        std::free(str);
+        json_decref(root);
+
+        uint32_t slots = numSlots(m_params, m_inputs, m_outputs);
+        m_frame.assign(slots, 0);
+        m_previous.assign(slots, 0);
+        m_changed.resize(slots);
+        m_stream.resize(capacity);
+        m_size = 0;
+        m_identical = 0;
+        m_samples = 0;
+        m_full = false;
+        m_state.store(RECORDING, std::memory_order_release);
+}
+
+void OrbitsCapture::stop(void)
+{
+        int expected = RECORDING;
+        m_state.compare_exchange_strong(expected, STOPPING);
+}
+
+bool OrbitsCapture::beginFrame(Module *module, const Module::ProcessArgs &args)
+{
+        int state = m_state.load(std::memory_order_acquire);
+        if(state == STOPPING)
+        {
+                finish();
+                return false;
+        }
+        if(state != RECORDING)
+        {
+                return false;
+        }
+
+        m_frame[0] = floatBits(args.sampleRate);
+        uint32_t slot = 1;
+        for(uint32_t p = 0; p < m_params; ++p)
+        {
+                m_frame[slot++] = floatBits(module->params[p].getValue());
+        }
+
+        // Voltages past the channel count keep their last value, they're never read
+        for(uint32_t i = 0; i < m_inputs; ++i)
+        {
+                Input &input = module->inputs[i];
+                int channels = input.getChannels();
+                m_frame[slot] = channels;
+                for(int c = 0; c < channels; ++c)
+                {
+                        m_frame[slot + 1 + c] = floatBits(input.getVoltage(c));
+                }
+                slot += 1 + PORT_MAX_CHANNELS;
+        }
+
+        m_in_frame = true;
+        m_draws = 0;
+        return true;
+}
+
+void OrbitsCapture::endFrame(Module *module)
+{
+        // Draws past the count keep their last value like unused channels
+        m_in_frame = false;
+        m_frame[drawsSlot(m_params, m_inputs, m_outputs)] = m_draws;
+
+        for(uint32_t o = 0; o < m_outputs; ++o)
+        {
+                Output &output = module->outputs[o];
+                uint32_t slot = outputSlot(o);
+                int channels = output.getChannels();
+                m_frame[slot] = channels;
+                for(int c = 0; c < channels; ++c)
+                {
+                        m_frame[slot + 1 + c] = floatBits(output.getVoltage(c));
+                }
+        }
+
+        uint32_t changes = 0;
+        for(uint32_t s = 0; s < m_frame.size(); ++s)
+        {
+                if(m_frame[s] != m_previous[s])
+                {
+                        m_changed[changes++] = s;
+                }
+        }
+
+        if(!changes)
+        {
+                ++m_identical;
+                ++m_samples;
+                return;
+        }
+
+        // Two varints for the record, a varint and a slot for each change and the end record
+        if(m_size + 10 + changes * 9 + 10 > capacity)
+        {
+                m_full = true;
+                finish();
+                return;
+        }
+
+        uint8_t *data = m_stream.data();
+        writeVarint(data, &m_size, m_identical);
+        writeVarint(data, &m_size, changes);
+        uint32_t next = 0;
+        for(uint32_t i = 0; i < changes; ++i)
+        {
+                uint32_t s = m_changed[i];
+                writeVarint(data, &m_size, s - next);
+                next = s + 1;
+                uint32_t bits = m_frame[s];
+                for(int b = 0; b < 4; ++b)
+                {
+                        data[m_size++] = bits >> (8 * b);
+                }
+                m_previous[s] = bits;
+        }
+        m_identical = 0;
+        ++m_samples;
+}
+
+float OrbitsCapture::uniform(void)
+{
+        if(isReplaying())
+        {
+                // Running out means process drew more than when it was recorded, the outputs will show it
+                return m_draws < std::min(m_replay_draws[0], max_draws) ? bitsFloat(m_replay_draws[1 + m_draws++]) : 0.f;
+        }
+
+        // Randomizing from the UI happens between frames and isn't recorded
+        float value = random::uniform();
+        if(m_in_frame && m_draws < max_draws)
+        {
+                m_frame[drawsSlot(m_params, m_inputs, m_outputs) + 1 + m_draws++] = floatBits(value);
+        }
+        return value;
+}
+
+void OrbitsCapture::finish(void)
+{
+        writeVarint(m_stream.data(), &m_size, m_identical);
+        writeVarint(m_stream.data(), &m_size, 0);
+        m_identical = 0;
+        m_in_frame = false;
+        m_state.store(STOPPED, std::memory_order_release);
+}
+
+bool OrbitsCapture::save(const std::string &path) const
+{
+        if(m_state.load(std::memory_order_acquire) != STOPPED)
+        {
+                return false;
+        }
+
+        FILE *file = std::fopen(path.c_str(), "wb");
+        if(!file)
+        {
+                return false;
+        }
+
+        // Native byte order, little endian on every platform Rack runs on
+        uint32_t header[5] = {magic, version, m_params, m_inputs, m_outputs};
+        uint32_t json_size = m_module_json.size();
+        uint64_t stream_size = m_size;
+        bool ok = std::fwrite(header, sizeof(header), 1, file) == 1 &&
+                  std::fwrite(&m_samples, sizeof(m_samples), 1, file) == 1 &&
+                  std::fwrite(&json_size, sizeof(json_size), 1, file) == 1 &&
+                  std::fwrite(m_module_json.data(), 1, json_size, file) == json_size &&
+                  std::fwrite(&stream_size, sizeof(stream_size), 1, file) == 1 &&
+                  std::fwrite(m_stream.data(), 1, m_size, file) == m_size;
+        return std::fclose(file) == 0 && ok;
+}
+
+std::string OrbitsCapture::replay(Model *model, OrbitsCapture *(*access)(Module *module), const std::string &path)
+{
+        FILE *file = std::fopen(path.c_str(), "rb");
+        if(!file)
+        {
+                return "No recording saved";
+        }
+
+        uint32_t header[5] = {};
+        uint64_t samples = 0;
+        uint32_t json_size = 0;
+        uint64_t stream_size = 0;
+        std::string module_json;
+        std::vector<uint8_t> stream;
+        bool ok = std::fread(header, sizeof(header), 1, file) == 1 && header[0] == magic && header[1] == version &&
+                  std::fread(&samples, sizeof(samples), 1, file) == 1 &&
+                  std::fread(&json_size, sizeof(json_size), 1, file) == 1;
+        if(ok)
+        {
+                module_json.resize(json_size);
+                ok = std::fread(&module_json[0], 1, json_size, file) == json_size &&
+                     std::fread(&stream_size, sizeof(stream_size), 1, file) == 1;
+        }
+        if(ok)
+        {
+                stream.resize(stream_size);
+                ok = std::fread(stream.data(), 1, stream_size, file) == stream_size;
+        }
+        std::fclose(file);
+        if(!ok)
+        {
+                return "Recording is unreadable";
+        }
+
+        uint32_t params = header[2];
+        uint32_t inputs = header[3];
+        uint32_t outputs = header[4];
+        Module *module = model->createModule();
+        if(module->params.size() != params || module->inputs.size() != inputs || module->outputs.size() != outputs)
+        {
+                delete module;
+                return "Recording is from a different version of the module";
+        }
+
+        // The replay must not join the live module's bus
+        json_t *root = json_loads(module_json.c_str(), 0, NULL);
+        json_object_del(json_object_get(root, "data"), "bus");
+        module->fromJson(root);
+        json_decref(root);
+
+        std::vector<uint32_t> frame(numSlots(params, inputs, outputs), 0);
+        OrbitsCapture *capture = access(module);
+        capture->m_state.store(REPLAYING);
+        capture->m_replay_draws = &frame[drawsSlot(params, inputs, outputs)];
+        Module::ProcessArgs args = {};
+        std::chrono::steady_clock::duration elapsed{};
+        std::string result;
+
+        // Plays one frame and returns false if the outputs differ from the recording
+        auto play = [&]() {
+                float sample_rate = bitsFloat(frame[0]);
+                if(sample_rate != args.sampleRate)
+                {
+                        args.sampleRate = sample_rate;
+                        args.sampleTime = 1.f / sample_rate;
+                        Module::SampleRateChangeEvent e;
+                        e.sampleRate = args.sampleRate;
+                        e.sampleTime = args.sampleTime;
+                        module->onSampleRateChange(e);
+                }
+
+                uint32_t slot = 1;
+                for(uint32_t p = 0; p < params; ++p)
+                {
+                        module->params[p].setValue(bitsFloat(frame[slot++]));
+                }
+                for(uint32_t i = 0; i < inputs; ++i)
+                {
+                        int channels = frame[slot];
+                        module->inputs[i].setChannels(channels);
+                        for(int c = 0; c < channels; ++c)
+                        {
+                                module->inputs[i].setVoltage(bitsFloat(frame[slot + 1 + c]), c);
+                        }
+                        slot += 1 + PORT_MAX_CHANNELS;
+                }
+
+                capture->m_draws = 0;
+                auto begin = std::chrono::steady_clock::now();
+                module->process(args);
+                elapsed += std::chrono::steady_clock::now() - begin;
+
+                for(uint32_t o = 0; o < outputs; ++o)
+                {
+                        int channels = frame[slot];
+                        if(module->outputs[o].getChannels() != channels)
+                        {
+                                result = string::f("Output %d channel count differs at sample %lld", o + 1,
+                                                   (long long)args.frame);
+                                return false;
+                        }
+                        for(int c = 0; c < channels; ++c)
+                        {
+                                if(floatBits(module->outputs[o].getVoltage(c)) != frame[slot + 1 + c])
+                                {
+                                        result = string::f("Output %d channel %d differs at sample %lld", o + 1, c + 1,
+                                                           (long long)args.frame);
+                                        return false;
+                                }
+                        }
+                        slot += 1 + PORT_MAX_CHANNELS;
+                }
+                ++args.frame;
+                return true;
+        };
+
+        size_t pos = 0;
+        bool identical = true;
+        while(identical)
+        {
+                uint32_t repeats, changes;
+                if(!readVarint(stream, &pos, &repeats) || !readVarint(stream, &pos, &changes))
+                {
+                        result = "Recording is truncated";
+                        identical = false;
+                        break;
+                }
+
+                for(uint32_t r = 0; r < repeats && identical; ++r)
+                {
+                        identical = play();
+                }
+                if(!changes || !identical)
+                {
+                        break;
+                }
+
+                uint32_t next = 0;
+                for(uint32_t i = 0; i < changes; ++i)
+                {
+                        uint32_t gap;
+                        if(!readVarint(stream, &pos, &gap) || pos + 4 > stream.size() || next + gap >= frame.size())
+                        {
+                                result = "Recording is truncated";
+                                identical = false;
+                                break;
+                        }
+                        uint32_t s = next + gap;
+                        frame[s] = stream[pos] | stream[pos + 1] << 8 | stream[pos + 2] << 16 |
+                                   (uint32_t)stream[pos + 3] << 24;
+                        pos += 4;
+                        next = s + 1;
+                }
+                if(identical)
+                {
+                        identical = play();
+                }
+        }
+        delete module;
+
+        if(identical)
+        {
+                double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+                result = string::f("%lld of %llu samples identical, %.1f ns per sample", (long long)args.frame,
+                                   (unsigned long long)samples, args.frame ? ns / args.frame : 0.0);
+        }
+        return result;
+}
+
+#endif
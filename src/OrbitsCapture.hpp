@@ -0,0 +1,141 @@
+#pragma once
+
+#include "plugin.hpp"
+
+// Records everything an Eugene or Polygene sees and produces so a session can be
+// replayed offline, part of the ORBITS_PROFILE build.
+//
+// Each sample is a frame of 32 bit slots: the sample rate, every param, the
+// channel count and voltages of every input and output, and the random numbers
+// process drew through ORBITS_UNIFORM. Frames are stored as the slots that changed
+// since the previous frame, runs of identical frames as a count, so constant gates
+// and untouched knobs cost nothing.
+//
+// Stream records are varint(identical frames) varint(changed slots) followed by
+// varint(slot index gap) and the 4 byte little endian slot for each change. A
+// record with no changes ends the stream.
+//
+// Replay creates a fresh instance of the module away from the engine, restores the
+// state saved when recording started, feeds it the recorded frames and checks
+// every output bit for bit. The module draws the recorded random numbers instead
+// of new ones, and doesn't add its randomizations to the undo history.
+
+#ifdef ORBITS_PROFILE
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct OrbitsCapture
+{
+        enum State
+        {
+                IDLE,
+                RECORDING,
+                // Set by the UI, the engine finishes the stream on the next sample
+                STOPPING,
+                STOPPED,
+                // A copy of the module being replayed, only ever set by replay()
+                REPLAYING
+        };
+
+        static const uint32_t magic = 0x4342524f; // "ORBC"
+        static const uint32_t version = 2;
+        static const size_t capacity = 32 << 20;
+        // Random numbers recorded per sample, a Polygene randomizing every channel at once draws 102
+        static const uint32_t max_draws = 128;
+
+        std::atomic<int> m_state{IDLE};
+
+        // Set up by the UI thread before recording starts
+        uint32_t m_params = 0;
+        uint32_t m_inputs = 0;
+        uint32_t m_outputs = 0;
+        std::string m_module_json;
+        std::vector<uint32_t> m_frame;
+        std::vector<uint32_t> m_previous;
+        std::vector<uint32_t> m_changed;
+        std::vector<uint8_t> m_stream;
+
+        // Engine thread while recording
+        size_t m_size = 0;
+        uint32_t m_identical = 0;
+        uint64_t m_samples = 0;
+        bool m_full = false;
+        bool m_in_frame = false;
+        uint32_t m_draws = 0;
+
+        // The draws slots of the frame being replayed
+        const uint32_t *m_replay_draws = nullptr;
+
+        // Result of the last replay for the menu, UI thread only
+        std::string m_replay_result;
+
+        // UI thread
+        void start(Module *module);
+        void stop(void);
+        bool save(const std::string &path) const;
+        static std::string replay(Model *model, OrbitsCapture *(*access)(Module *module), const std::string &path);
+
+        // Engine thread, around process. beginFrame returns true if the frame is being recorded
+        bool beginFrame(Module *module, const Module::ProcessArgs &args);
+        void endFrame(Module *module);
+        void finish(void);
+
+        // A random number in [0, 1) like random::uniform(), recorded while recording and the
+        // recorded one while replaying
+        float uniform(void);
+
+        bool isReplaying(void) const
+        {
+                return m_state.load(std::memory_order_relaxed) == REPLAYING;
+        }
+
+        static uint32_t numSlots(uint32_t params, uint32_t inputs, uint32_t outputs)
+        {
+                return drawsSlot(params, inputs, outputs) + 1 + max_draws;
+        }
+
+        // The count of random numbers drawn, followed by each of them
+        static uint32_t drawsSlot(uint32_t params, uint32_t inputs, uint32_t outputs)
+        {
+                return 1 + params + (inputs + outputs) * (1 + PORT_MAX_CHANNELS);
+        }
+
+        uint32_t outputSlot(uint32_t output) const
+        {
+                return 1 + m_params + (m_inputs + output) * (1 + PORT_MAX_CHANNELS);
+        }
+};
+
+// Records the inputs on construction and the outputs on destruction, so early returns from process are covered
+struct OrbitsCaptureScope
+{
+        OrbitsCapture &m_capture;
+        Module *m_module;
+        bool m_recording;
+
+        OrbitsCaptureScope(OrbitsCapture &capture, Module *module, const Module::ProcessArgs &args)
+                : m_capture(capture), m_module(module), m_recording(capture.beginFrame(module, args))
+        {
+        }
+
+        ~OrbitsCaptureScope()
+        {
+                if(m_recording)
+                {
+                        m_capture.endFrame(m_module);
+                }
+        }
+};
+
+#define ORBITS_CAPTURE(capture, module, args) OrbitsCaptureScope orbits_capture_scope((capture), (module), (args))
+#define ORBITS_UNIFORM(capture) (capture).uniform()
+
+#else
+
+#define ORBITS_CAPTURE(capture, module, args)
+#define ORBITS_UNIFORM(capture) random::uniform()
+
+#endif
@@ -55,6 +55,76 @@ OrbitsConfig::OrbitsConfig(std::string path)
         m_path = path;
 }
 
+void OrbitsConfig::load()
+{
+        if(m_loaded)
+        {
+                return;
+        }
+        m_loaded = true;
+
+        json_error_t error;
+        std::string path = asset::plugin(pluginInstance, m_path);
+        json_t *root = orbits_json_load_file(path.c_str(), 0, &error);
+        json_t *def = json_object_get(root, "default");
+        const char *default_name = json_string_value(def);
+        json_t *themes = json_object_get(root, "themes");
+        size_t index;
+        json_t *value;
+        json_array_foreach(themes, index, value)
+        {
+                OrbitsTheme theme;
+                const char *key;
+                json_t *obj;
+                json_object_foreach(value, key, obj)
+                {
+                        const char *str = json_string_value(obj);
+                        if(std::string(key) == "name")
+                        {
+                                theme.name = str ? str : "";
+                        }
+                        else if(str)
+                        {
+                                theme.svgs[key] = asset::plugin(pluginInstance, std::string("res/") + str);
+                        }
+                        else if(json_is_array(obj))
+                        {
+                                std::array<uint8_t, 3> colour;
+                                for(auto i = 0u; i < 3; ++i)
+                                {
+                                        json_t *c = json_array_get(obj, i);
+                                        colour[i] = json_integer_value(c);
+                                }
+                                theme.colours[key] = colour;
+                        }
+                }
+
+                m_themes.push_back(theme);
+        }
+
+        for(size_t i = 0; i < m_themes.size(); ++i)
+        {
+                if(default_name && m_themes[i].name == default_name)
+                {
+                        m_default_theme = i;
+                        break;
+                }
+        }
+        json_decref(root);
+
+        m_panel = read_file_contents(getSvg("panel"));
+}
+
+const OrbitsTheme *OrbitsConfig::getTheme(int theme)
+{
+        load();
+        if(theme < 0 || theme >= (int)m_themes.size())
+        {
+                return NULL;
+        }
+        return &m_themes[theme];
+}
+
 float OrbitsConfig::rFindFloatAttribute(std::string &content, std::string attribute, size_t search)
 {
         search = content.rfind(attribute + "=", search);
@@ -78,16 +148,13 @@ float OrbitsConfig::rFindFloatAttribute(std::string &content, std::string attrib
 
 std::string OrbitsConfig::getSvg(std::string component, int theme)
 {
-        json_error_t error;
-        std::string path = asset::plugin(pluginInstance, m_path);
-        json_t *root = orbits_json_load_file(path.c_str(), 0, &error);
-        json_t *themes = json_object_get(root, "themes");
-        json_t *entry = json_array_get(themes, theme);
-        json_t *obj = json_object_get(entry, component.c_str());
-        const char *str = json_string_value(obj);
-        std::string svg = str ? asset::plugin(pluginInstance, std::string("res/") + str) : "";
-        json_decref(root);
-        return svg;
+        const OrbitsTheme *entry = getTheme(theme);
+        if(!entry)
+        {
+                return "";
+        }
+        auto svg = entry->svgs.find(component);
+        return svg == entry->svgs.end() ? "" : svg->second;
 }
 
 std::string OrbitsConfig::getSvg(std::string component)
@@ -95,9 +162,29 @@ std::string OrbitsConfig::getSvg(std::string component)
         return getSvg(component, getDefaultThemeId());
 }
 
+const std::vector<std::shared_ptr<window::Svg>> &OrbitsConfig::getSvgs(const std::string &component)
+{
+        auto found = m_svgs.find(component);
+        if(found != m_svgs.end())
+        {
+                return found->second;
+        }
+
+        // Themes without the component keep the default theme's SVG
+        std::vector<std::shared_ptr<window::Svg>> &svgs = m_svgs[component];
+        std::string fallback = getSvg(component);
+        for(size_t i = 0; i < numThemes(); ++i)
+        {
+                std::string path = getSvg(component, i);
+                svgs.push_back(APP->window->loadSvg(path.empty() ? fallback : path));
+        }
+        return svgs;
+}
+
 Vec OrbitsConfig::getPos(std::string component)
 {
-        std::string content = read_file_contents(getSvg("panel"));
+        load();
+        std::string &content = m_panel;
         size_t search = content.find("inkscape:label=\"components\"");
         if(search == std::string::npos)
         {
@@ -119,7 +206,8 @@ Vec OrbitsConfig::getPos(std::string component)
 
 Vec OrbitsConfig::getSize(std::string component)
 {
-        std::string content = read_file_contents(getSvg("panel"));
+        load();
+        std::string &content = m_panel;
         size_t search = content.find("inkscape:label=\"components\"");
         search = content.find("inkscape:label=\"" + component, search);
         float w = rFindFloatAttribute(content, "width", search);
@@ -129,16 +217,8 @@ Vec OrbitsConfig::getSize(std::string component)
 
 std::string OrbitsConfig::getThemeName(int theme)
 {
-        json_error_t error;
-        std::string path = asset::plugin(pluginInstance, m_path);
-        json_t *root = orbits_json_load_file(path.c_str(), 0, &error);
-        json_t *themes = json_object_get(root, "themes");
-        json_t *entry = json_array_get(themes, theme);
-        json_t *name = json_object_get(entry, "name");
-        const char *theme_name = json_string_value(name);
-        std::string theme_name_str = theme_name ? theme_name : "";
-        json_decref(root);
-        return theme_name_str;
+        const OrbitsTheme *entry = getTheme(theme);
+        return entry ? entry->name : "";
 }
 
 std::string OrbitsConfig::getThemeName()
@@ -148,80 +228,39 @@ std::string OrbitsConfig::getThemeName()
 
 std::vector<std::string> OrbitsConfig::getThemeNames()
 {
+        load();
         std::vector<std::string> names;
-
-        json_error_t error;
-        std::string path = asset::plugin(pluginInstance, m_path);
-        json_t *root = orbits_json_load_file(path.c_str(), 0, &error);
-        json_t *themes = json_object_get(root, "themes");
-        size_t index;
-        json_t *value;
-        json_array_foreach(themes, index, value)
+        for(const OrbitsTheme &theme : m_themes)
         {
-                json_t *name = json_object_get(value, "name");
-                const char *theme_name = json_string_value(name);
-                names.push_back(theme_name);
-
+                names.push_back(theme.name);
         }
-        json_decref(root);
-
         return names;
 }
 
 int OrbitsConfig::getDefaultThemeId()
 {
-        int default_theme_id = 0;
-        json_error_t error;
-        std::string path = asset::plugin(pluginInstance, m_path);
-        json_t *root = orbits_json_load_file(path.c_str(), 0, &error);
-        json_t *def = json_object_get(root, "default");
-        const char *default_name = json_string_value(def);
-        json_t *themes = json_object_get(root, "themes");
-        size_t index;
-        json_t *value;
-        json_array_foreach(themes, index, value)
-        {
-                json_t *name = json_object_get(value, "name");
-                const char *theme_name = json_string_value(name);
-                if(theme_name && default_name && (std::string(theme_name) == std::string(default_name)))
-                {
-                        default_theme_id = index;
-                        break;
-                }
-        }
-        json_decref(root);
-
-        return default_theme_id;
+        load();
+        return m_default_theme;
 }
 
 size_t OrbitsConfig::numThemes()
 {
-        json_error_t error;
-        std::string path = asset::plugin(pluginInstance, m_path);
-        json_t *root = orbits_json_load_file(path.c_str(), 0, &error);
-        json_t *themes = json_object_get(root, "themes");
-        size_t count = json_array_size(themes);
-        json_decref(root);
-        return count;
+        load();
+        return m_themes.size();
 }
 
 std::array<uint8_t, 3> OrbitsConfig::getColour(std::string component, int theme)
 {
-        json_error_t error;
-        std::string path = asset::plugin(pluginInstance, m_path);
-        json_t *root = orbits_json_load_file(path.c_str(), 0, &error);
-        json_t *themes = json_object_get(root, "themes");
-        json_t *entry = json_array_get(themes, theme);
-        json_t *obj = json_object_get(entry, component.c_str());
-
-        std::array<uint8_t, 3> colour;
-        for(auto i = 0u; i < 3; ++i)
+        std::array<uint8_t, 3> colour = {};
+        const OrbitsTheme *entry = getTheme(theme);
+        if(entry)
         {
-                json_t *c = json_array_get(obj, i);
-                colour[i] = json_integer_value(c);
+                auto found = entry->colours.find(component);
+                if(found != entry->colours.end())
+                {
+                        colour = found->second;
+                }
         }
-
-        json_decref(root);
         return colour;
 }
 
@@ -1,13 +1,27 @@
 #pragma once
 
 #include <array>
+#include <map>
+#include <memory>
+#include <vector>
 #include "plugin.hpp"
 
+// A theme from the layout JSON, resolved to SVG paths and colours
+struct OrbitsTheme
+{
+        std::string name;
+        std::map<std::string, std::string> svgs;
+        std::map<std::string, std::array<uint8_t, 3>> colours;
+};
+
 struct OrbitsConfig
 {
         OrbitsConfig(std::string path);
         std::string getSvg(std::string component, int theme);
         std::string getSvg(std::string component);
+        // The SVG of a component in every theme, indexed by theme, loaded once on the UI thread.
+        // Switching theme picks a handle from here instead of reading the layout and SVG files.
+        const std::vector<std::shared_ptr<window::Svg>> &getSvgs(const std::string &component);
         Vec getPos(std::string component);
         Vec getSize(std::string component);
         std::string getThemeName(int theme);
@@ -19,5 +33,15 @@ struct OrbitsConfig
         size_t numThemes();
 private:
         std::string m_path;
+        // The theme atlas, read from the layout JSON on first use because the
+        // plugin's asset paths aren't known when the static configs are created
+        bool m_loaded = false;
+        std::vector<OrbitsTheme> m_themes;
+        int m_default_theme = 0;
+        std::map<std::string, std::vector<std::shared_ptr<window::Svg>>> m_svgs;
+        // The default panel, where the component positions come from
+        std::string m_panel;
+        void load();
+        const OrbitsTheme *getTheme(int theme);
         float rFindFloatAttribute(std::string &content, std::string attribute, size_t search);        
 };
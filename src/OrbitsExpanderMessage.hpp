@@ -0,0 +1,129 @@
+#pragma once
+
+#include "plugin.hpp"
+
+#include <cstdint>
+#include <type_traits>
+
+// Eugene and Polygene publish their rhythm state every sample for modules
+// placed directly next to them. Like every expander message in Rack the
+// receiver owns the double buffer: a module that wants the state points the
+// leftExpander and/or rightExpander facing the Orbits module at two messages
+// set up with initOrbitsExpanderMessages(). The Orbits module writes the
+// producerMessage and requests a flip, the receiver reads its own
+// consumerMessage in place using getOrbitsExpanderMessage().
+//
+// The magic and version in the buffers tell the Orbits module the neighbour
+// takes the message, nothing is written to a neighbour without them.
+//
+// The layout is fixed, only ever extended at the end, and the version is
+// bumped when it changes so other plugins can copy this header.
+
+static const uint32_t ORBITS_EXPANDER_MAGIC = 0x5342524f; // "ORBS"
+static const uint32_t ORBITS_EXPANDER_VERSION = 2;
+
+struct OrbitsExpanderChannel
+{
+        // One bit per step, bit 0 is the first step, invert already applied
+        uint32_t pattern;
+        // Number of cycles completed since the module was reset
+        uint32_t cycles;
+        // The step played on the last clock edge
+        uint8_t step;
+        uint8_t length;
+        // The step played on the last clock edge was an on beat
+        uint8_t on_beat;
+        uint8_t reverse;
+};
+
+struct OrbitsExpanderMessage
+{
+        uint32_t magic;
+        uint32_t version;
+        uint32_t channels;
+        OrbitsExpanderChannel channel[PORT_MAX_CHANNELS];
+};
+
+static_assert(std::is_trivially_copyable<OrbitsExpanderMessage>::value, "Expander message must be POD");
+static_assert(std::is_standard_layout<OrbitsExpanderMessage>::value, "Expander message must be POD");
+
+inline bool isOrbitsExpanderMessage(const void *message)
+{
+        auto header = static_cast<const OrbitsExpanderMessage *>(message);
+        return header && header->magic == ORBITS_EXPANDER_MAGIC && header->version == ORBITS_EXPANDER_VERSION;
+}
+
+// Called by a receiver to take messages from the Orbits module on one side of it
+inline void initOrbitsExpanderMessages(Module::Expander &expander, OrbitsExpanderMessage messages[2])
+{
+        for(int i = 0; i < 2; ++i)
+        {
+                messages[i] = {};
+                messages[i].magic = ORBITS_EXPANDER_MAGIC;
+                messages[i].version = ORBITS_EXPANDER_VERSION;
+        }
+        expander.producerMessage = &messages[0];
+        expander.consumerMessage = &messages[1];
+}
+
+// Returns the message received through expander, or NULL if the neighbour on that side
+// isn't an Orbits module. The message is left alone once the Orbits module is removed.
+inline const OrbitsExpanderMessage *getOrbitsExpanderMessage(const Module::Expander &expander)
+{
+        if(!expander.module || expander.module->model->plugin->slug != "RareBreeds_Orbits" ||
+           !isOrbitsExpanderMessage(expander.consumerMessage))
+        {
+                return NULL;
+        }
+
+        return static_cast<const OrbitsExpanderMessage *>(expander.consumerMessage);
+}
+
+// Writes the message to every neighbour that takes it, used by Eugene, Polygene and the bank
+struct OrbitsExpanderPublisher
+{
+        OrbitsExpanderMessage m_message = {};
+
+        // Returns the message to fill in, or NULL if there's nobody to read it
+        OrbitsExpanderMessage *begin(Module *module)
+        {
+                if(!takesMessage(module, module->leftExpander.module, false) &&
+                   !takesMessage(module, module->rightExpander.module, true))
+                {
+                        return NULL;
+                }
+
+                m_message.magic = ORBITS_EXPANDER_MAGIC;
+                m_message.version = ORBITS_EXPANDER_VERSION;
+                return &m_message;
+        }
+
+        void end(Module *module)
+        {
+                send(module, module->leftExpander.module, false);
+                send(module, module->rightExpander.module, true);
+        }
+
+        // A neighbour on the right receives through its leftExpander and the other way around
+        static Module::Expander &facing(Module *neighbour, bool right)
+        {
+                return right ? neighbour->leftExpander : neighbour->rightExpander;
+        }
+
+        // Orbits modules use their expanders for their own messages, which another module may be writing
+        static bool takesMessage(Module *module, Module *neighbour, bool right)
+        {
+                return neighbour && neighbour->model->plugin != module->model->plugin &&
+                       isOrbitsExpanderMessage(facing(neighbour, right).producerMessage);
+        }
+
+        void send(Module *module, Module *neighbour, bool right)
+        {
+                if(takesMessage(module, neighbour, right))
+                {
+                        Module::Expander &expander = facing(neighbour, right);
+                        *static_cast<OrbitsExpanderMessage *>(expander.producerMessage) = m_message;
+                        expander.messageFlipRequested = true;
+                }
+        }
+};
@@ -60,11 +60,22 @@ void EOCMode::dataFromJson(json_t *root)
 
 void EOCGenerator::update(EOCMode &mode, bool is_first, bool is_last)
 {
-        if(eoc_mode_options.process(mode.getMode(), is_first, is_last, m_previous_beat_was_last))
+        if(isEndOfCycle(mode, is_first, is_last))
         {
-                m_generator.trigger(1e-3f);
+                trigger();
         }
+}
+
+bool EOCGenerator::isEndOfCycle(EOCMode &mode, bool is_first, bool is_last)
+{
+        bool eoc = eoc_mode_options.process(mode.getMode(), is_first, is_last, m_previous_beat_was_last);
         m_previous_beat_was_last = is_last;
+        return eoc;
+}
+
+void EOCGenerator::trigger(void)
+{
+        m_generator.trigger(1e-3f);
 }
 
 bool EOCGenerator::process(float delta)
@@ -144,3 +155,688 @@ bool BeatGenerator::process(BeatMode &mode, float delta)
         bool pulse = m_generator.process(delta);
         return beat_mode_options.process(mode.getMode(), pulse, m_state);
 }
+
+static const SwingModeOptions swing_mode_options;
+
+bool SwingModeOptions::process(int mode, unsigned int step) const
+{
+        return options[mode]->process(step);
+}
+
+std::vector<std::string> SwingModeOptions::getOptions(void) const
+{
+        std::vector<std::string> opts;
+        for(auto option : options)
+        {
+                opts.push_back(option->desc);
+        }
+        return opts;
+}
+
+SwingModeOptions::~SwingModeOptions()
+{
+        for(auto i : options)
+        {
+                delete i;
+        }
+}
+
+size_t SwingModeOptions::size() const
+{
+        return options.size();
+}
+
+int SwingMode::getMode(void)
+{
+        return m_mode;
+}
+
+void SwingMode::setMode(int mode)
+{
+        m_mode = math::clamp(mode, 0, swing_mode_options.size() - 1);
+}
+
+std::vector<std::string> SwingMode::getOptions(void)
+{
+        return swing_mode_options.getOptions();
+}
+
+json_t *SwingMode::dataToJson(void)
+{
+        return json_integer(m_mode);
+}
+
+void SwingMode::dataFromJson(json_t *root)
+{
+        if(root)
+        {
+                setMode(json_integer_value(root));
+        }
+}
+
+float SwingMode::delay(unsigned int step, float swing, float offset)
+{
+        float delay = offset;
+        if(swing_mode_options.process(m_mode, step))
+        {
+                delay += swing;
+        }
+        return math::clamp(delay, 0.f, SwingDelay::max_delay);
+}
+
+static const AccentModeOptions accent_mode_options;
+
+static uint32_t gcd(uint32_t a, uint32_t b)
+{
+        while(b)
+        {
+                uint32_t t = a % b;
+                a = b;
+                b = t;
+        }
+        return a;
+}
+
+float AccentModeOptionMetric::weight(uint32_t pattern, uint32_t length, uint32_t step) const
+{
+        // Steps that divide the cycle into fewer equal parts are stronger, the
+        // first step is strongest. For a length of 16 the middle step is 3/4,
+        // the quarters 1/2, the eighths 1/4 and every other step 0.
+        if(step == 0)
+        {
+                return 1.f;
+        }
+        return std::log2((float)gcd(step, length)) / std::log2((float)length);
+}
+
+float AccentModeOptionGap::weight(uint32_t pattern, uint32_t length, uint32_t step) const
+{
+        // Steps since the previous on beat compared to the longest gap in the pattern
+        uint32_t gap = 0;
+        uint32_t longest = 0;
+        uint32_t step_gap = 0;
+        for(uint32_t i = 0; i < 2 * length; ++i)
+        {
+                // Going round twice so the first on beats see the gap at the end of the cycle
+                ++gap;
+                if((pattern >> (i % length)) & 1)
+                {
+                        if(i >= length)
+                        {
+                                longest = std::max(longest, gap);
+                                if(i - length == step)
+                                {
+                                        step_gap = gap;
+                                }
+                        }
+                        gap = 0;
+                }
+        }
+        return (float)step_gap / longest;
+}
+
+float AccentModeOptions::weight(int mode, uint32_t pattern, uint32_t length, uint32_t step) const
+{
+        return options[mode]->weight(pattern, length, step);
+}
+
+std::vector<std::string> AccentModeOptions::getOptions(void) const
+{
+        std::vector<std::string> opts;
+        for(auto option : options)
+        {
+                opts.push_back(option->desc);
+        }
+        return opts;
+}
+
+AccentModeOptions::~AccentModeOptions()
+{
+        for(auto i : options)
+        {
+                delete i;
+        }
+}
+
+size_t AccentModeOptions::size() const
+{
+        return options.size();
+}
+
+int AccentMode::getMode(void)
+{
+        return m_mode;
+}
+
+void AccentMode::setMode(int mode)
+{
+        m_mode = math::clamp(mode, 0, accent_mode_options.size() - 1);
+}
+
+std::vector<std::string> AccentMode::getOptions(void)
+{
+        return accent_mode_options.getOptions();
+}
+
+json_t *AccentMode::dataToJson(void)
+{
+        return json_integer(m_mode);
+}
+
+void AccentMode::dataFromJson(json_t *root)
+{
+        if(root)
+        {
+                setMode(json_integer_value(root));
+        }
+}
+
+void AccentTable::update(const AccentMode &mode, const PatternCache &pattern)
+{
+        if(pattern.m_length == m_length && pattern.m_word == m_word && mode.m_mode == m_mode)
+        {
+                return;
+        }
+
+        m_length = pattern.m_length;
+        m_word = pattern.m_word;
+        m_mode = mode.m_mode;
+
+        // The quietest accent is a quarter of the loudest so every on beat can be heard
+        for(uint32_t step = 0; step < m_length; ++step)
+        {
+                float weight = 0.f;
+                if((m_word >> step) & 1)
+                {
+                        weight = accent_mode_options.weight(m_mode, m_word, m_length, step);
+                }
+                m_levels[step] = 0.25f + 0.75f * weight;
+        }
+}
+
+void SwingDelay::schedule(float delay, bool beat, bool eoc, BeatGenerator &beat_generator, EOCGenerator &eoc_generator)
+{
+        SwingEvent event;
+        event.due = m_now + (uint32_t)(delay * m_clock.getPeriod() + 0.5f);
+        event.beat = beat;
+        event.eoc = eoc;
+
+        if(!m_queue.push(event))
+        {
+                // Only happens if the clock speeds up dramatically while
+                // events are pending, play it now rather than lose it.
+                beat_generator.update(beat);
+                if(eoc)
+                {
+                        eoc_generator.trigger();
+                }
+        }
+}
+
+void SwingDelay::process(BeatGenerator &beat_generator, EOCGenerator &eoc_generator)
+{
+        SwingEvent event;
+        while(m_queue.pop(m_now, &event))
+        {
+                beat_generator.update(event.beat);
+                if(event.eoc)
+                {
+                        eoc_generator.trigger();
+                }
+        }
+}
+
+bool PatternCache::update(uint32_t length, uint32_t hits, uint32_t shift, uint32_t variation, bool invert)
+{
+        if(length == m_length && hits == m_hits && shift == m_shift && variation == m_variation && invert == m_invert)
+        {
+                return false;
+        }
+
+        m_length = length;
+        m_hits = hits;
+        m_shift = shift;
+        m_variation = variation;
+        m_invert = invert;
+        m_morphed = false;
+
+        auto pattern = rhythm::rotate(rhythm::nearEvenRhythm(length, hits, variation), length, shift);
+        if(invert)
+        {
+                pattern.flip();
+        }
+        m_word = rhythm::word(pattern, length);
+        return true;
+}
+
+void PatternCache::set(uint32_t length, uint32_t word)
+{
+        m_length = length;
+        m_word = word;
+        m_morphed = false;
+
+        // The parameters no longer describe the pattern, make sure the next update recalculates it
+        m_hits = UINT32_MAX;
+}
+
+void PatternCache::morph(const MorphCache &morph, float position, uint32_t shift, bool invert)
+{
+        uint32_t word = rhythm::rotateWord(morph.at(position), morph.m_length, shift);
+        if(invert)
+        {
+                word = rhythm::word(~rhythm::Rhythm(word), morph.m_length);
+        }
+        set(morph.m_length, word);
+        m_shift = shift;
+        m_invert = invert;
+        m_morphed = true;
+        m_position = position;
+}
+
+bool PatternCache::followMorph(MorphCache &morph, uint32_t target_hits, float position)
+{
+        if(!m_morphed || (target_hits == morph.m_target_hits && position == m_position))
+        {
+                return false;
+        }
+
+        morph.update(morph.m_length, morph.m_hits, morph.m_variation, target_hits);
+        PatternCache::morph(morph, position, m_shift, m_invert);
+        return true;
+}
+
+void MorphCache::update(uint32_t length, uint32_t hits, uint32_t variation, uint32_t target_hits)
+{
+        if(length == m_length && hits == m_hits && variation == m_variation && target_hits == m_target_hits)
+        {
+                return;
+        }
+
+        m_length = length;
+        m_hits = hits;
+        m_variation = variation;
+        m_target_hits = target_hits;
+
+        uint32_t from = rhythm::word(rhythm::nearEvenRhythm(length, hits, variation), length);
+        uint32_t to = rhythm::word(rhythm::nearEvenRhythm(length, target_hits, 0), length);
+        m_size = rhythm::morphPath(length, from, to, m_path);
+}
+
+const PatternCache &NestedPatternCache::update(const PatternCache &outer, const PatternCache &inner)
+{
+        if(outer.m_length != m_outer_length || outer.m_word != m_outer_word || inner.m_length != m_inner_length ||
+           inner.m_word != m_inner_word)
+        {
+                m_outer_length = outer.m_length;
+                m_outer_word = outer.m_word;
+                m_inner_length = inner.m_length;
+                m_inner_word = inner.m_word;
+
+                uint32_t length;
+                uint32_t word = rhythm::nest(m_outer_word, m_outer_length, m_inner_word, m_inner_length, &length);
+                m_pattern.set(length, word);
+        }
+
+        return m_pattern;
+}
+
+void AnalysisCache::update(const PatternCache &pattern)
+{
+        if(pattern.m_length == m_length && pattern.m_word == m_word)
+        {
+                return;
+        }
+
+        m_length = pattern.m_length;
+        m_word = pattern.m_word;
+
+        rhythm::Analysis analysis = rhythm::analyse(m_length, m_word);
+        uint32_t onsets = __builtin_popcount(m_word);
+        float max_evenness = rhythm::maxEvenness(m_length, onsets);
+        m_evenness = max_evenness > 0.f ? std::min(analysis.evenness / max_evenness, 1.f) : 0.f;
+        m_off_beatness = analysis.off_beatness;
+        m_density = (float)onsets / m_length;
+        m_odd = analysis.odd;
+}
+
+uint64_t SongEntry::pack(void) const
+{
+        return (uint64_t)length | (uint64_t)hits << 6 | (uint64_t)shift << 12 | (uint64_t)variation << 17 |
+               (uint64_t)reverse << 23 | (uint64_t)invert << 24 | (uint64_t)repeats << 25;
+}
+
+SongEntry SongEntry::unpack(uint64_t packed)
+{
+        SongEntry entry;
+        entry.length = math::clamp((int)(packed & 0x3f), 1, (int)rhythm::max_length);
+        entry.hits = math::clamp((int)(packed >> 6 & 0x3f), 0, (int)entry.length);
+        entry.shift = (packed >> 12 & 0x1f) % entry.length;
+        entry.variation = packed >> 17 & 0x3f;
+        entry.reverse = packed >> 23 & 1;
+        entry.invert = packed >> 24 & 1;
+        entry.repeats = std::max((int)(packed >> 25 & 0xff), 1);
+        return entry;
+}
+
+bool Song::add(const SongEntry &entry)
+{
+        if(m_size == max_entries)
+        {
+                return false;
+        }
+
+        m_entries[m_size++] = entry;
+        compile();
+        return true;
+}
+
+void Song::remove(int index)
+{
+        if(index < 0 || index >= m_size)
+        {
+                return;
+        }
+
+        std::copy(m_entries + index + 1, m_entries + m_size, m_entries + index);
+        --m_size;
+        compile();
+}
+
+void Song::clear(void)
+{
+        m_size = 0;
+        compile();
+}
+
+void Song::compile(void)
+{
+        std::unique_ptr<CompiledList> list(new CompiledList);
+        for(int i = 0; i < m_size; ++i)
+        {
+                const SongEntry &entry = m_entries[i];
+                auto count = rhythm::numNearEvenRhythms(entry.length, entry.hits);
+                auto variation = std::min<uint32_t>(entry.variation, count - 1);
+                auto pattern = rhythm::rotate(rhythm::nearEvenRhythm(entry.length, entry.hits, variation), entry.length,
+                                              entry.shift);
+                if(entry.invert)
+                {
+                        pattern.flip();
+                }
+
+                Compiled &compiled = list->m_entries[i];
+                compiled.pattern = rhythm::word(pattern, entry.length);
+                compiled.length = entry.length;
+                compiled.hits = entry.hits;
+                compiled.shift = entry.shift;
+                compiled.invert = entry.invert;
+                compiled.reverse = entry.reverse;
+                compiled.repeats = entry.repeats;
+        }
+        list->m_size = m_size;
+        m_compiled.store(list.get(), std::memory_order_release);
+        m_lists.push_back(std::move(list));
+
+        // The audio thread only ever takes the newest list, so lists older than the one it took are unused
+        const CompiledList *taken = m_taken.load(std::memory_order_acquire);
+        auto it = std::find_if(m_lists.begin(), m_lists.end(),
+                               [taken](const std::unique_ptr<CompiledList> &l) {return l.get() == taken;});
+        if(it != m_lists.end())
+        {
+                m_lists.erase(m_lists.begin(), it);
+        }
+}
+
+void Song::requestRestart(void)
+{
+        m_restart_requested.store(true, std::memory_order_release);
+}
+
+json_t *Song::dataToJson(void)
+{
+        json_t *root = json_object();
+        if(root)
+        {
+                json_object_set_new(root, "enabled", json_boolean(m_enabled));
+
+                json_t *entries = json_array();
+                if(entries)
+                {
+                        for(int i = 0; i < m_size; ++i)
+                        {
+                                json_array_append_new(entries, json_integer(m_entries[i].pack()));
+                        }
+                        json_object_set_new(root, "entries", entries);
+                }
+        }
+        return root;
+}
+
+void Song::dataFromJson(json_t *root)
+{
+        if(root)
+        {
+                json_t *enabled = json_object_get(root, "enabled");
+                if(enabled)
+                {
+                        m_enabled = json_boolean_value(enabled);
+                }
+
+                m_size = 0;
+                size_t index;
+                json_t *entry;
+                json_array_foreach(json_object_get(root, "entries"), index, entry)
+                {
+                        if(m_size < max_entries)
+                        {
+                                m_entries[m_size++] = SongEntry::unpack(json_integer_value(entry));
+                        }
+                }
+
+                compile();
+                requestRestart();
+        }
+}
+
+const Song::CompiledList *Song::playing(void) const
+{
+        const CompiledList *list = m_taken.load(std::memory_order_relaxed);
+        return m_enabled && list && list->m_size > 0 ? list : NULL;
+}
+
+const Song::Compiled &Song::current(const CompiledList &list) const
+{
+        // The song may have been shortened since the entry started
+        return list.m_entries[m_position < list.m_size ? m_position : 0];
+}
+
+const Song::CompiledList *Song::update(void)
+{
+        if(m_restart_requested.load(std::memory_order_relaxed) && m_restart_requested.exchange(false))
+        {
+                restart();
+        }
+        m_taken.store(m_compiled.load(std::memory_order_acquire), std::memory_order_release);
+        return playing();
+}
+
+void Song::endOfCycle(const CompiledList &list)
+{
+        int size = list.m_size;
+        if(size == 0)
+        {
+                return;
+        }
+
+        if(m_position >= size)
+        {
+                restart();
+        }
+
+        if(++m_repeat >= current(list).repeats)
+        {
+                m_repeat = 0;
+                m_position = (m_position + 1) % size;
+        }
+}
+
+void Song::restart(void)
+{
+        m_position = 0;
+        m_repeat = 0;
+}
+
+void Lookahead::update(const PatternCache &pattern, uint32_t step, bool reverse, uint32_t period)
+{
+        // Start a new ramp on each on beat, otherwise carry on from where
+        // the ramp is so it stays continuous when the clock rate changes
+        if(pattern.beat(step))
+        {
+                m_ramp = 0.f;
+        }
+
+        m_steps = rhythm::stepsToNextBeat(pattern.m_word, pattern.m_length, step, reverse);
+        if(m_steps && period)
+        {
+                m_increment = (1.f - m_ramp) / (m_steps * period);
+        }
+        else
+        {
+                m_ramp = 0.f;
+                m_increment = 0.f;
+        }
+}
+
+void Lookahead::reset(void)
+{
+        m_steps = 0;
+        m_ramp = 0.f;
+        m_increment = 0.f;
+}
+
+void SwingDelay::reset(void)
+{
+        m_clock.reset();
+        m_queue.clear();
+        m_now = 0;
+}
+
+const float *MinBlep::impulse(void)
+{
+        struct Table
+        {
+                float samples[length * oversample + 1];
+
+                Table()
+                {
+                        dsp::minBlepImpulse(zero_crossings, oversample, samples);
+                        samples[length * oversample] = 1.f;
+                }
+        };
+
+        static const Table table;
+        return table.samples;
+}
+
+const ClockRatio clock_ratios[num_clock_ratios] = {
+        {1, 8, "x1/8"},
+        {1, 6, "x1/6"},
+        {1, 4, "x1/4"},
+        {1, 3, "x1/3"},
+        {1, 2, "x1/2"},
+        {2, 3, "x2/3"},
+        {3, 4, "x3/4"},
+        {1, 1, "x1"},
+        {4, 3, "x4/3"},
+        {3, 2, "x3/2"},
+        {2, 1, "x2"},
+        {3, 1, "x3"},
+        {4, 1, "x4"},
+        {6, 1, "x6"},
+        {8, 1, "x8"},
+};
+
+static const char base64_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+std::string encodeBase64(const uint8_t *data, size_t size)
+{
+        std::string text((size + 2) / 3 * 4, '=');
+        char *out = &text[0];
+        size_t i = 0;
+        for(; i + 3 <= size; i += 3)
+        {
+                uint32_t block = data[i] << 16 | data[i + 1] << 8 | data[i + 2];
+                *out++ = base64_alphabet[block >> 18];
+                *out++ = base64_alphabet[(block >> 12) & 0x3f];
+                *out++ = base64_alphabet[(block >> 6) & 0x3f];
+                *out++ = base64_alphabet[block & 0x3f];
+        }
+
+        // The padding is already in place
+        if(i < size)
+        {
+                uint32_t block = data[i] << 16 | (i + 1 < size ? data[i + 1] << 8 : 0);
+                *out++ = base64_alphabet[block >> 18];
+                *out++ = base64_alphabet[(block >> 12) & 0x3f];
+                if(i + 1 < size)
+                {
+                        *out++ = base64_alphabet[(block >> 6) & 0x3f];
+                }
+        }
+        return text;
+}
+
+bool decodeBase64(const char *text, size_t length, std::vector<uint8_t> *data)
+{
+        // Each character's 6 bits, or 0xff for characters that aren't in the alphabet
+        struct Table
+        {
+                uint8_t values[256];
+
+                Table()
+                {
+                        std::fill(values, values + 256, 0xff);
+                        for(int i = 0; i < 64; ++i)
+                        {
+                                values[(uint8_t)base64_alphabet[i]] = i;
+                        }
+                }
+        };
+        static const Table table;
+
+        if(length % 4)
+        {
+                return false;
+        }
+        size_t padding = 0;
+        while(padding < 2 && padding < length && text[length - 1 - padding] == '=')
+        {
+                ++padding;
+        }
+
+        data->resize(length / 4 * 3 - padding);
+        uint8_t *out = data->data();
+        uint8_t *end = out + data->size();
+        for(size_t i = 0; i < length; i += 4)
+        {
+                uint32_t a = table.values[(uint8_t)text[i]];
+                uint32_t b = table.values[(uint8_t)text[i + 1]];
+                uint32_t c = i + 4 < length || padding < 2 ? table.values[(uint8_t)text[i + 2]] : 0;
+                uint32_t d = i + 4 < length || padding < 1 ? table.values[(uint8_t)text[i + 3]] : 0;
+                if((a | b | c | d) & 0xc0)
+                {
+                        return false;
+                }
+
+                uint32_t block = a << 18 | b << 12 | c << 6 | d;
+                *out++ = block >> 16;
+                if(out < end)
+                {
+                        *out++ = block >> 8;
+                }
+                if(out < end)
+                {
+                        *out++ = block;
+                }
+        }
+        return true;
+}
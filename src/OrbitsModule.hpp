@@ -1,6 +1,10 @@
 #pragma once
 
 #include "plugin.hpp"
+#include "AudioRatePattern.hpp"
+#include "Rhythm.hpp"
+#include <atomic>
+#include <memory>
 #include <vector>
 
 struct EOCModeOption
@@ -81,6 +85,8 @@ struct EOCGenerator
         dsp::PulseGenerator m_generator;
         bool m_previous_beat_was_last = false;
         void update(EOCMode &mode, bool is_first, bool is_last);
+        bool isEndOfCycle(EOCMode &mode, bool is_first, bool is_last);
+        void trigger(void);
         bool process(float delta);
 };
 
@@ -192,3 +198,715 @@ struct RepeatTrigger
                 return false;
         }
 };
+
+struct SwingModeOption
+{
+        const char *desc;
+        SwingModeOption(const char *_desc) : desc{_desc}
+        {
+        }
+
+        virtual bool process(unsigned int step) const = 0;
+
+        virtual ~SwingModeOption()
+        {
+        }
+};
+
+struct SwingModeOptionOddSteps : SwingModeOption
+{
+        SwingModeOptionOddSteps() : SwingModeOption("Odd Steps")
+        {
+        }
+
+        bool process(unsigned int step) const override
+        {
+                return step % 2;
+        }
+};
+
+struct SwingModeOptionEvenSteps : SwingModeOption
+{
+        SwingModeOptionEvenSteps() : SwingModeOption("Even Steps")
+        {
+        }
+
+        bool process(unsigned int step) const override
+        {
+                return !(step % 2);
+        }
+};
+
+struct SwingModeOptionAllSteps : SwingModeOption
+{
+        SwingModeOptionAllSteps() : SwingModeOption("All Steps")
+        {
+        }
+
+        bool process(unsigned int step) const override
+        {
+                return true;
+        }
+};
+
+class SwingModeOptions
+{
+      public:
+        bool process(int mode, unsigned int step) const;
+        std::vector<std::string> getOptions(void) const;
+        ~SwingModeOptions();
+        size_t size() const;
+
+      private:
+        std::vector<SwingModeOption *> options{new SwingModeOptionOddSteps, new SwingModeOptionEvenSteps,
+                                               new SwingModeOptionAllSteps};
+};
+
+struct SwingMode
+{
+        int m_mode = 0;
+
+        int getMode(void);
+        void setMode(int mode);
+        std::vector<std::string> getOptions(void);
+        json_t *dataToJson(void);
+        void dataFromJson(json_t *root);
+
+        // The delay applied to a step as a fraction of the clock period.
+        // The swing amount only applies to the steps selected by the mode,
+        // the per step offset (from CV) applies to every step.
+        float delay(unsigned int step, float swing, float offset);
+};
+
+struct AccentModeOption
+{
+        const char *desc;
+        AccentModeOption(const char *_desc) : desc{_desc}
+        {
+        }
+
+        // Weight of the on beat at step between 0 and 1, pattern has at least one on beat
+        virtual float weight(uint32_t pattern, uint32_t length, uint32_t step) const = 0;
+
+        virtual ~AccentModeOption()
+        {
+        }
+};
+
+struct AccentModeOptionMetric : AccentModeOption
+{
+        AccentModeOptionMetric() : AccentModeOption("Metric")
+        {
+        }
+
+        float weight(uint32_t pattern, uint32_t length, uint32_t step) const override;
+};
+
+struct AccentModeOptionGap : AccentModeOption
+{
+        AccentModeOptionGap() : AccentModeOption("Gap Before")
+        {
+        }
+
+        float weight(uint32_t pattern, uint32_t length, uint32_t step) const override;
+};
+
+struct AccentModeOptionRising : AccentModeOption
+{
+        AccentModeOptionRising() : AccentModeOption("Rising")
+        {
+        }
+
+        float weight(uint32_t pattern, uint32_t length, uint32_t step) const override
+        {
+                return (step + 1.f) / length;
+        }
+};
+
+struct AccentModeOptionFalling : AccentModeOption
+{
+        AccentModeOptionFalling() : AccentModeOption("Falling")
+        {
+        }
+
+        float weight(uint32_t pattern, uint32_t length, uint32_t step) const override
+        {
+                return (float)(length - step) / length;
+        }
+};
+
+class AccentModeOptions
+{
+      public:
+        float weight(int mode, uint32_t pattern, uint32_t length, uint32_t step) const;
+        std::vector<std::string> getOptions(void) const;
+        ~AccentModeOptions();
+        size_t size() const;
+
+      private:
+        std::vector<AccentModeOption *> options{new AccentModeOptionMetric, new AccentModeOptionGap,
+                                                new AccentModeOptionRising, new AccentModeOptionFalling};
+};
+
+struct AccentMode
+{
+        int m_mode = 0;
+
+        int getMode(void);
+        void setMode(int mode);
+        std::vector<std::string> getOptions(void);
+        json_t *dataToJson(void);
+        void dataFromJson(json_t *root);
+};
+
+// Measures the number of samples between rising clock edges
+struct ClockPeriod
+{
+        uint32_t m_samples_since_edge = 0;
+        uint32_t m_period = 0;
+        bool m_seen_edge = false;
+
+        void process(bool edge)
+        {
+                if(edge)
+                {
+                        // The time before the first edge isn't a clock period
+                        m_period = m_seen_edge ? m_samples_since_edge : 0;
+                        m_samples_since_edge = 0;
+                        m_seen_edge = true;
+                }
+
+                if(m_samples_since_edge < UINT32_MAX)
+                {
+                        ++m_samples_since_edge;
+                }
+        }
+
+        uint32_t getPeriod(void) const
+        {
+                return m_period;
+        }
+
+        void reset(void)
+        {
+                m_samples_since_edge = 0;
+                m_period = 0;
+                m_seen_edge = false;
+        }
+};
+
+// A channel's clock as a ratio of the internal clock's beats
+struct ClockRatio
+{
+        uint32_t numerator;
+        uint32_t denominator;
+        const char *name;
+};
+
+static const int num_clock_ratios = 15;
+static const int default_clock_ratio = 7;
+extern const ClockRatio clock_ratios[num_clock_ratios];
+
+// Internal clock for patches without a clock module. The phase is counted in beats
+// in double precision so channels multiplied and divided from it stay in step
+// however long the patch runs.
+struct MasterClock
+{
+        // Every ratio denominator divides this, wrapping here keeps each channel on its grid
+        static constexpr double wrap = 840.0;
+
+        double m_phase = 0.0;
+        // Phase added by the last sample
+        double m_increment = 0.0;
+        // Following an external clock the phase stops short of its next beat
+        double m_next_beat = 0.0;
+        ClockPeriod m_external_period;
+
+        // Free running, tempo is in beats per second
+        void process(float tempo, float sample_time)
+        {
+                m_increment = (double)tempo * sample_time;
+                m_phase += m_increment;
+                if(m_phase >= wrap)
+                {
+                        m_phase -= wrap;
+                }
+        }
+
+        // Follows an external clock, the tempo comes from the time between its edges
+        void processExternal(bool edge)
+        {
+                m_external_period.process(edge);
+                if(edge)
+                {
+                        m_phase = m_next_beat >= wrap ? m_next_beat - wrap : m_next_beat;
+                        m_next_beat = m_phase + 1.0;
+                        m_increment = 0.0;
+                }
+                else if(m_external_period.getPeriod())
+                {
+                        m_increment = 1.0 / m_external_period.getPeriod();
+                        m_phase = std::min(m_phase + m_increment, m_next_beat - 1e-9);
+                }
+        }
+
+        void reset(void)
+        {
+                m_phase = 0.0;
+                m_increment = 0.0;
+                m_next_beat = 0.0;
+                m_external_period.reset();
+        }
+};
+
+// Clock edges at a ratio of the internal clock
+struct RatioClock
+{
+        int64_t m_tick = -1;
+        // Where the edge was in the sample, like crossingPosition()
+        float m_position = 0.f;
+
+        bool process(const MasterClock &clock, const ClockRatio &ratio)
+        {
+                double ticks = clock.m_phase * ratio.numerator / ratio.denominator;
+                int64_t tick = (int64_t)std::floor(ticks);
+                if(tick == m_tick)
+                {
+                        return false;
+                }
+
+                m_tick = tick;
+                double increment = clock.m_increment * ratio.numerator / ratio.denominator;
+                m_position = increment > 0.0 ? -(float)std::min((ticks - tick) / increment, 1.0) : 0.f;
+                return true;
+        }
+
+        void reset(void)
+        {
+                m_tick = -1;
+                m_position = 0.f;
+        }
+};
+
+struct SwingEvent
+{
+        uint32_t due;
+        bool beat;
+        bool eoc;
+};
+
+// Fixed capacity queue of events ordered by the sample they are due on.
+// Delays are always less than a clock period so only a couple of events
+// are ever pending, a sorted insert is cheaper than anything cleverer.
+template <size_t CAPACITY>
+struct SwingEventQueue
+{
+        SwingEvent m_events[CAPACITY];
+        size_t m_size = 0;
+
+        static bool isDue(uint32_t due, uint32_t now)
+        {
+                // Wrap safe comparison of sample counters
+                return (int32_t)(now - due) >= 0;
+        }
+
+        bool push(const SwingEvent &event)
+        {
+                if(m_size == CAPACITY)
+                {
+                        return false;
+                }
+
+                // Events due on the same sample keep the order they were pushed
+                size_t i = m_size;
+                while(i > 0 && (int32_t)(m_events[i - 1].due - event.due) > 0)
+                {
+                        m_events[i] = m_events[i - 1];
+                        --i;
+                }
+                m_events[i] = event;
+                ++m_size;
+                return true;
+        }
+
+        bool pop(uint32_t now, SwingEvent *event)
+        {
+                if(m_size == 0 || !isDue(m_events[0].due, now))
+                {
+                        return false;
+                }
+
+                *event = m_events[0];
+                --m_size;
+                for(size_t i = 0; i < m_size; ++i)
+                {
+                        m_events[i] = m_events[i + 1];
+                }
+                return true;
+        }
+
+        void clear(void)
+        {
+                m_size = 0;
+        }
+};
+
+// Delays beat and EOC events by a fraction of the measured clock period
+struct SwingDelay
+{
+        static constexpr float max_delay = 0.9f;
+
+        ClockPeriod m_clock;
+        SwingEventQueue<8> m_queue;
+        uint32_t m_now = 0;
+
+        // Call once per sample before scheduling or processing events
+        void step(bool clock_edge)
+        {
+                m_clock.process(clock_edge);
+                ++m_now;
+        }
+
+        void schedule(float delay, bool beat, bool eoc, BeatGenerator &beat_generator, EOCGenerator &eoc_generator);
+        void process(BeatGenerator &beat_generator, EOCGenerator &eoc_generator);
+        void reset(void);
+};
+
+// A path of patterns from one number of hits to another, changing one step at a
+// time. Only recalculated when the length or hits change, so sweeping along
+// the path is a table lookup.
+struct MorphCache
+{
+        uint32_t m_length = 0;
+        uint32_t m_hits = UINT32_MAX;
+        uint32_t m_variation = 0;
+        uint32_t m_target_hits = 0;
+        uint32_t m_size = 0;
+        uint32_t m_path[rhythm::max_length + 1];
+
+        // The path starts at the variation and ends on the first variation of target_hits
+        void update(uint32_t length, uint32_t hits, uint32_t variation, uint32_t target_hits);
+
+        // Unshifted pattern from position 0 (the start of the path) to 1 (the end)
+        uint32_t at(float position) const
+        {
+                return m_path[(uint32_t)(math::clamp(position, 0.f, 1.f) * (m_size - 1) + 0.5f)];
+        }
+};
+
+// The pattern word for the current rhythm parameters, only recalculated when they change
+struct PatternCache
+{
+        uint32_t m_length = 0;
+        uint32_t m_hits = 0;
+        uint32_t m_shift = 0;
+        uint32_t m_variation = 0;
+        bool m_invert = false;
+        uint32_t m_word = 0;
+        // Set when the word came from morph(), position is where along the path
+        bool m_morphed = false;
+        float m_position = 0.f;
+
+        // Returns true if the pattern changed
+        bool update(uint32_t length, uint32_t hits, uint32_t shift, uint32_t variation, bool invert);
+
+        // Use a pattern that has already been calculated
+        void set(uint32_t length, uint32_t word);
+
+        // Use the pattern at position along a morph path
+        void morph(const MorphCache &morph, float position, uint32_t shift, bool invert);
+
+        // Between clocks, moves a morphed pattern to a new target and position along the path, the other
+        // settings stay as they were on the last clock. Returns true if it was morphed again
+        bool followMorph(MorphCache &morph, uint32_t target_hits, float position);
+
+        bool beat(uint32_t step) const
+        {
+                return (m_word >> step) & 1;
+        }
+};
+
+// The outer pattern with the inner pattern played on each of its on beats, only recomposed when either changes
+struct NestedPatternCache
+{
+        uint32_t m_outer_length = 0;
+        uint32_t m_outer_word = 0;
+        uint32_t m_inner_length = 0;
+        uint32_t m_inner_word = 0;
+        PatternCache m_pattern;
+
+        const PatternCache &update(const PatternCache &outer, const PatternCache &inner);
+};
+
+// Analysis of the current pattern scaled to [0, 1], only recalculated when the pattern changes
+struct AnalysisCache
+{
+        uint32_t m_length = 0;
+        uint32_t m_word = 0;
+        float m_evenness = 0.f;
+        float m_off_beatness = 0.f;
+        float m_density = 0.f;
+        bool m_odd = false;
+
+        void update(const PatternCache &pattern);
+};
+
+// Accent level of each step of the current pattern, only recalculated when the pattern or mode changes
+struct AccentTable
+{
+        uint32_t m_length = 0;
+        uint32_t m_word = 0;
+        int m_mode = -1;
+        float m_levels[rhythm::max_length] = {};
+
+        void update(const AccentMode &mode, const PatternCache &pattern);
+
+        float level(uint32_t step) const
+        {
+                return m_levels[step];
+        }
+};
+
+struct SongEntry
+{
+        uint8_t length, hits, shift, variation;
+        bool reverse, invert;
+        uint8_t repeats;
+
+        // Packed into a single integer for storing in the patch
+        uint64_t pack(void) const;
+        static SongEntry unpack(uint64_t packed);
+};
+
+// An ordered list of rhythm settings, each played for a number of cycles.
+// Entries are edited on the UI thread and compiled into pattern words, the
+// audio thread only reads the compiled list so never calculates a rhythm.
+//
+// Each compile publishes a new list. The audio thread takes the latest list
+// once per process(), plays from it throughout and records which one it took.
+// Lists older than the one it took are freed on the next compile, so usually
+// only the published list and the one before it are kept.
+struct Song
+{
+        static const int max_entries = 64;
+
+        struct Compiled
+        {
+                uint32_t pattern;
+                uint8_t length;
+                bool reverse;
+                uint8_t repeats;
+
+                // Only for the display
+                uint8_t hits, shift;
+                bool invert;
+        };
+
+        struct CompiledList
+        {
+                Compiled m_entries[max_entries];
+                int m_size = 0;
+        };
+
+        SongEntry m_entries[max_entries];
+        int m_size = 0;
+
+        // Lists the audio thread may still play, oldest first, the last one is current
+        std::vector<std::unique_ptr<CompiledList>> m_lists;
+        std::atomic<const CompiledList *> m_compiled{nullptr};
+        // The list the audio thread took last, set by update()
+        std::atomic<const CompiledList *> m_taken{nullptr};
+
+        std::atomic<bool> m_enabled{false};
+        // Set by the UI thread, the audio thread goes back to the first entry
+        std::atomic<bool> m_restart_requested{false};
+        int m_position = 0;
+        int m_repeat = 0;
+
+        // UI thread
+        bool add(const SongEntry &entry);
+        void remove(int index);
+        void clear(void);
+        void compile(void);
+        void requestRestart(void);
+        json_t *dataToJson(void);
+        void dataFromJson(json_t *root);
+
+        // Audio thread, update() is called once per process() and returns playing()
+        // The list taken by the last update(), NULL when the song isn't playing
+        const CompiledList *playing(void) const;
+        const Compiled &current(const CompiledList &list) const;
+        const CompiledList *update(void);
+        void endOfCycle(const CompiledList &list);
+        void restart(void);
+};
+
+// Where in the last sample the voltage crossed the threshold, -1 is the previous sample and 0 is this one
+inline float crossingPosition(float previous, float current, float threshold)
+{
+        float delta = current - previous;
+        return delta != 0.f ? math::clamp((threshold - current) / delta, -1.f, 0.f) : 0.f;
+}
+
+inline simd::float_4 crossingPosition(simd::float_4 previous, simd::float_4 current, float threshold)
+{
+        simd::float_4 delta = current - previous;
+        simd::float_4 moved = delta != 0.f;
+        simd::float_4 position = (threshold - current) / simd::ifelse(moved, delta, 1.f);
+        return simd::ifelse(moved, simd::clamp(position, -1.f, 0.f), 0.f);
+}
+
+// The minimum phase band limited step shared by every PrecisionOutputs
+struct MinBlep
+{
+        static const int zero_crossings = 16;
+        static const int oversample = 16;
+        static const int length = 2 * zero_crossings;
+
+        // Calculated on first use, length * oversample + 1 samples ending at 1
+        static const float *impulse(void);
+};
+
+// Replaces the instant 0V to 10V steps of N gate outputs with band limited ones placed
+// where the clock edge happened inside the sample, like dsp::MinBlepGenerator but with
+// a position for each channel. The correction for a step is spread over the following
+// MinBlep::length samples.
+template <int N>
+struct PrecisionOutputs
+{
+        static_assert(N % 4 == 0, "Channels are processed 4 at a time");
+
+        float m_levels[N] = {};
+        float m_buffer[MinBlep::length][N] = {};
+        int m_pos = 0;
+
+        PrecisionOutputs()
+        {
+                // Modules are created on the UI thread, keep the table calculation off the audio thread
+                MinBlep::impulse();
+        }
+
+        // voltages are the plain gate levels and are replaced with the band limited ones,
+        // positions are where each channel's last clock edge was from crossingPosition()
+        void process(float *voltages, const float *positions, int channels)
+        {
+                for(int c = 0; c < channels; ++c)
+                {
+                        float jump = voltages[c] - m_levels[c];
+                        if(jump != 0.f)
+                        {
+                                insert(c, positions[c], jump);
+                                m_levels[c] = voltages[c];
+                        }
+                }
+
+                float *correction = m_buffer[m_pos];
+                for(int c = 0; c < channels; c += 4)
+                {
+                        simd::float_4 v = simd::float_4::load(voltages + c) + simd::float_4::load(correction + c);
+                        v.store(voltages + c);
+                }
+                std::fill(correction, correction + N, 0.f);
+                m_pos = (m_pos + 1) % MinBlep::length;
+        }
+
+        void insert(int channel, float position, float jump)
+        {
+                const float *impulse = MinBlep::impulse();
+                for(int j = 0; j < MinBlep::length; ++j)
+                {
+                        float index = (j - position) * MinBlep::oversample;
+                        int i = std::min((int)index, MinBlep::length * MinBlep::oversample - 1);
+                        float value = impulse[i] + (impulse[i + 1] - impulse[i]) * (index - i);
+                        m_buffer[(m_pos + j) % MinBlep::length][channel] += jump * (value - 1.f);
+                }
+        }
+};
+
+// Distance to the next on beat and a ramp that reaches 1 on it
+struct Lookahead
+{
+        uint32_t m_steps = 0;
+        float m_ramp = 0.f;
+        float m_increment = 0.f;
+
+        // Call on each clock edge with the step that was just played
+        void update(const PatternCache &pattern, uint32_t step, bool reverse, uint32_t period);
+
+        float process(void)
+        {
+                m_ramp = std::min(m_ramp + m_increment, 1.f);
+                return m_ramp;
+        }
+
+        void reset(void);
+};
+
+// The data shown on a display, published by the engine as a snapshot the UI only copies. The engine
+// compares the data every check_interval samples, a few milliseconds at most, far more often than
+// the UI redraws, and only writes the snapshot when it changed. The generation is odd while the
+// snapshot is being written and moves on with every write, so the UI draws only when there's
+// something new and retries a copy that overlapped a write.
+template <typename T>
+struct DisplayWatch
+{
+        static const unsigned int check_interval = 128;
+
+        // Even and not 0, so a new display reads the snapshot once before the engine publishes
+        std::atomic<uint32_t> m_generation{2};
+        T m_data = {};
+        // The first sample publishes, so the display never draws an empty snapshot for long
+        unsigned int m_samples = check_interval - 1;
+
+        // Engine thread, read returns the data shown on the display and is only called on checked samples
+        template <typename Read>
+        void process(Read read)
+        {
+                if(++m_samples < check_interval)
+                {
+                        return;
+                }
+                m_samples = 0;
+
+                T data = read();
+                if(data != m_data)
+                {
+                        uint32_t generation = m_generation.load(std::memory_order_relaxed);
+                        m_generation.store(generation + 1, std::memory_order_relaxed);
+                        std::atomic_thread_fence(std::memory_order_release);
+                        m_data = data;
+                        m_generation.store(generation + 2, std::memory_order_release);
+                }
+        }
+
+        // UI thread
+        uint32_t getGeneration(void) const
+        {
+                return m_generation.load(std::memory_order_acquire);
+        }
+
+        // UI thread, copies the latest snapshot
+        T read(void) const
+        {
+                for(;;)
+                {
+                        uint32_t generation = m_generation.load(std::memory_order_acquire);
+                        if(generation & 1)
+                        {
+                                continue;
+                        }
+                        T data = m_data;
+                        std::atomic_thread_fence(std::memory_order_acquire);
+                        if(m_generation.load(std::memory_order_relaxed) == generation)
+                        {
+                                return data;
+                        }
+                }
+        }
+};
+
+// Base64 for packed module state. Unlike string::toBase64() and string::fromBase64() these
+// write straight into a buffer sized up front, and decoding returns false instead of
+// throwing on anything that isn't base64.
+std::string encodeBase64(const uint8_t *data, size_t size);
+bool decodeBase64(const char *text, size_t length, std::vector<uint8_t> *data);
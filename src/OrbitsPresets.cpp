@@ -0,0 +1,185 @@
+#include "OrbitsPresets.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <sys/stat.h>
+
+static void loadPreset(OrbitsPreset *preset, OrbitsPresetDecoder decode)
+{
+        FILE *file = std::fopen(preset->m_path.c_str(), "rb");
+        if(!file)
+        {
+                WARN("Couldn't open preset %s", preset->m_path.c_str());
+                return;
+        }
+
+        json_error_t error;
+        json_t *root = json_loadf(file, 0, &error);
+        std::fclose(file);
+        if(!root)
+        {
+                WARN("Couldn't parse preset %s: %s", preset->m_path.c_str(), error.text);
+                return;
+        }
+        preset->m_json.reset(root, json_decref);
+
+        size_t index;
+        json_t *param;
+        json_array_foreach(json_object_get(root, "params"), index, param)
+        {
+                json_t *value = json_object_get(param, "value");
+                if(value)
+                {
+                        json_t *id = json_object_get(param, "id");
+                        preset->m_param_ids.push_back(id ? (int)json_integer_value(id) : (int)index);
+                        preset->m_param_values.push_back(json_number_value(value));
+                }
+        }
+
+        json_t *data = json_object_get(root, "data");
+        if(data && decode)
+        {
+                preset->m_state = decode(data);
+        }
+}
+
+void OrbitsPreset::applyParams(Module *module) const
+{
+        for(size_t i = 0; i < m_param_ids.size(); ++i)
+        {
+                int id = m_param_ids[i];
+                if(id >= 0 && id < (int)module->params.size())
+                {
+                        module->params[id].setValue(m_param_values[i]);
+                }
+        }
+}
+
+std::shared_ptr<const OrbitsPresetList> OrbitsPresetIndex::get(Model *model, OrbitsPresetDecoder decode)
+{
+        // The current list of each model, replacing it frees the old one unless a module still holds it
+        static std::map<std::string, std::shared_ptr<const OrbitsPresetList>> indexes;
+        std::shared_ptr<const OrbitsPresetList> &current = indexes[model->slug];
+
+        // Factory presets first, then the user's, like Rack's preset menu
+        std::vector<std::string> paths;
+        for(const std::string &directory : {model->getFactoryPresetDirectory(), model->getUserPresetDirectory()})
+        {
+                if(system::isDirectory(directory))
+                {
+                        std::vector<std::string> entries = system::getEntries(directory);
+                        std::sort(entries.begin(), entries.end());
+                        for(const std::string &entry : entries)
+                        {
+                                if(string::endsWith(entry, ".vcvm"))
+                                {
+                                        paths.push_back(entry);
+                                }
+                        }
+                }
+        }
+
+        std::map<std::string, const OrbitsPreset *> previous;
+        if(current)
+        {
+                for(const OrbitsPreset &preset : current->m_presets)
+                {
+                        previous[preset.m_path] = &preset;
+                }
+        }
+
+        std::shared_ptr<OrbitsPresetList> list = std::make_shared<OrbitsPresetList>();
+        bool changed = !current || current->m_presets.size() != paths.size();
+        for(size_t i = 0; i < paths.size(); ++i)
+        {
+                OrbitsPreset preset;
+                preset.m_path = paths[i];
+                preset.m_name = system::getStem(paths[i]);
+                struct stat info;
+                if(stat(paths[i].c_str(), &info) == 0)
+                {
+                        preset.m_mtime = info.st_mtime;
+                        preset.m_size = info.st_size;
+                }
+
+                auto found = previous.find(paths[i]);
+                if(found != previous.end() && found->second->m_mtime == preset.m_mtime &&
+                   found->second->m_size == preset.m_size)
+                {
+                        // Shares the parsed file with the previous list
+                        list->m_presets.push_back(*found->second);
+                        changed = changed || current->m_presets[i].m_path != paths[i];
+                }
+                else
+                {
+                        loadPreset(&preset, decode);
+                        list->m_presets.push_back(preset);
+                        changed = true;
+                }
+        }
+
+        if(changed)
+        {
+                INFO("Indexed %d presets for %s", (int)list->m_presets.size(), model->slug.c_str());
+                current = list;
+        }
+        return current;
+}
+
+void OrbitsPresetCV::setList(std::shared_ptr<const OrbitsPresetList> list)
+{
+        if(!m_lists.empty() && m_lists.back() == list)
+        {
+                return;
+        }
+        m_list.store(list.get(), std::memory_order_release);
+        m_lists.push_back(list);
+
+        // The engine only ever reads the newest list, so lists older than the one it read are unused
+        const OrbitsPresetList *taken = m_taken.load(std::memory_order_acquire);
+        auto it = std::find_if(m_lists.begin(), m_lists.end(),
+                               [taken](const std::shared_ptr<const OrbitsPresetList> &l) {return l.get() == taken;});
+        if(it != m_lists.end())
+        {
+                m_lists.erase(m_lists.begin(), it);
+        }
+}
+
+std::shared_ptr<const OrbitsPresetList> OrbitsPresetCV::getList(void) const
+{
+        return m_lists.empty() ? nullptr : m_lists.back();
+}
+
+// Fraction of a preset's share of the CV range
+static const float preset_cv_hysteresis = 0.1f;
+
+const OrbitsPreset *OrbitsPresetCV::process(bool connected, float cv)
+{
+        const OrbitsPresetList *list = m_list.load(std::memory_order_acquire);
+        m_taken.store(list, std::memory_order_release);
+        if(!connected || !list || list->m_presets.empty())
+        {
+                // Connecting again applies the preset under the CV
+                m_index = -1;
+                return NULL;
+        }
+
+        int count = list->m_presets.size();
+        float position = cv / 10.f * count;
+        int index = math::clamp((int)position, 0, count - 1);
+        if(index == m_index)
+        {
+                return NULL;
+        }
+
+        // Noise on a CV resting near the edge of a preset would switch back and forth every
+        // few samples, so the CV has to move a little past the edge first
+        if(m_index >= 0 && m_index < count && position > m_index - preset_cv_hysteresis &&
+           position < m_index + 1 + preset_cv_hysteresis)
+        {
+                return NULL;
+        }
+        m_index = index;
+        return &list->m_presets[index];
+}
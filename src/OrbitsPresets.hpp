@@ -0,0 +1,74 @@
+#pragma once
+
+#include "plugin.hpp"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Every factory and user preset of a model, parsed once and kept in memory so the
+// context menu and the expander preset CV switch presets without touching the files.
+//
+// The index is refreshed on the UI thread when a widget is created and when its
+// context menu opens. Only files whose modification time or size changed are parsed
+// again. A refresh that finds a change publishes a new list, the index only keeps
+// the current list of each model. Each preset CV holds on to the lists its engine
+// may still be reading, so a replaced list is freed once no module uses it.
+
+// Module state decoded from the "data" of a preset, each module adds what it needs
+struct OrbitsPresetState
+{
+        virtual ~OrbitsPresetState() {}
+};
+
+typedef std::shared_ptr<const OrbitsPresetState> (*OrbitsPresetDecoder)(json_t *data);
+
+struct OrbitsPreset
+{
+        std::string m_name;
+        std::string m_path;
+        int64_t m_mtime = 0;
+        int64_t m_size = 0;
+        // The whole file, NULL if it couldn't be parsed
+        std::shared_ptr<json_t> m_json;
+        // Params in the order of the file, ids fall back to the position like Rack's
+        std::vector<int> m_param_ids;
+        std::vector<float> m_param_values;
+        std::shared_ptr<const OrbitsPresetState> m_state;
+
+        // Engine thread
+        void applyParams(Module *module) const;
+};
+
+struct OrbitsPresetList
+{
+        std::vector<OrbitsPreset> m_presets;
+};
+
+struct OrbitsPresetIndex
+{
+        // UI thread, refreshes the index of the model and returns its current list
+        static std::shared_ptr<const OrbitsPresetList> get(Model *model, OrbitsPresetDecoder decode);
+};
+
+// Chooses a preset with a 0V to 10V CV, the presets are spread evenly over the range.
+// The CV has to pass a tenth of a preset beyond the current one before it changes.
+struct OrbitsPresetCV
+{
+        // Lists the engine may still read, oldest first, the last one is current
+        std::vector<std::shared_ptr<const OrbitsPresetList>> m_lists;
+        std::atomic<const OrbitsPresetList *> m_list{nullptr};
+        // The list the engine read last, set by process()
+        std::atomic<const OrbitsPresetList *> m_taken{nullptr};
+
+        // Engine thread
+        int m_index = -1;
+
+        // UI thread, publishes a new list and lets go of the lists the engine has moved past
+        void setList(std::shared_ptr<const OrbitsPresetList> list);
+        std::shared_ptr<const OrbitsPresetList> getList(void) const;
+
+        // The preset to apply when the CV moves onto a different one, otherwise NULL
+        const OrbitsPreset *process(bool connected, float cv);
+};
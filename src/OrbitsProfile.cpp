@@ -0,0 +1,90 @@
+#include "OrbitsProfile.hpp"
+
+#ifdef ORBITS_PROFILE
+
+#include <algorithm>
+#include <vector>
+
+uint32_t OrbitsTrace::copy(OrbitsTraceEvent *events) const
+{
+        uint64_t end = m_written.load(std::memory_order_acquire);
+        uint64_t begin = end > size ? end - size : 0;
+        for(uint64_t i = begin; i < end; ++i)
+        {
+                events[i - begin] = m_events[i % size];
+        }
+
+        // The engine kept recording while copying, the oldest events may have been overwritten
+        // and the slot after the last one counted may be half written
+        uint64_t written = m_written.load(std::memory_order_acquire) + 1;
+        uint64_t valid = written > size ? written - size : 0;
+        uint64_t skip = std::min(end, std::max(begin, valid)) - begin;
+        std::copy(events + skip, events + (end - begin), events);
+        return end - begin - skip;
+}
+
+bool OrbitsTrace::save(const std::string &path, const std::string &name, float sample_rate) const
+{
+        static const char *names[OrbitsTraceEvent::NUM_TYPES] = {
+                "Clock", "Beat", "EOC", "Sync", "Randomize", "Pattern", "Input mode"
+        };
+
+        std::vector<OrbitsTraceEvent> events(size);
+        uint32_t count = copy(events.data());
+
+        json_t *trace_events = json_array();
+        bool channels[256] = {};
+        for(uint32_t i = 0; i < count; ++i)
+        {
+                const OrbitsTraceEvent &event = events[i];
+                json_t *e = json_object();
+                json_object_set_new(e, "name", json_string(names[event.type]));
+                json_object_set_new(e, "ph", json_string("i"));
+                json_object_set_new(e, "s", json_string("t"));
+                json_object_set_new(e, "ts", json_real(event.frame * 1e6 / sample_rate));
+                json_object_set_new(e, "pid", json_integer(1));
+                json_object_set_new(e, "tid", json_integer(event.channel));
+
+                json_t *args = json_object();
+                json_object_set_new(args, "frame", json_integer(event.frame));
+                json_object_set_new(args, "value", json_integer(event.value));
+                json_object_set_new(e, "args", args);
+                json_array_append_new(trace_events, e);
+                channels[event.channel] = true;
+        }
+
+        // Name the process after the module and each thread after a channel
+        json_t *process_name = json_object();
+        json_object_set_new(process_name, "name", json_string("process_name"));
+        json_object_set_new(process_name, "ph", json_string("M"));
+        json_object_set_new(process_name, "pid", json_integer(1));
+        json_t *process_args = json_object();
+        json_object_set_new(process_args, "name", json_string(name.c_str()));
+        json_object_set_new(process_name, "args", process_args);
+        json_array_append_new(trace_events, process_name);
+
+        for(int c = 0; c < 256; ++c)
+        {
+                if(channels[c])
+                {
+                        json_t *thread_name = json_object();
+                        json_object_set_new(thread_name, "name", json_string("thread_name"));
+                        json_object_set_new(thread_name, "ph", json_string("M"));
+                        json_object_set_new(thread_name, "pid", json_integer(1));
+                        json_object_set_new(thread_name, "tid", json_integer(c));
+                        json_t *thread_args = json_object();
+                        json_object_set_new(thread_args, "name", json_string(string::f("Channel %d", c + 1).c_str()));
+                        json_object_set_new(thread_name, "args", thread_args);
+                        json_array_append_new(trace_events, thread_name);
+                }
+        }
+
+        json_t *root = json_object();
+        json_object_set_new(root, "traceEvents", trace_events);
+        json_object_set_new(root, "displayTimeUnit", json_string("ms"));
+        bool ok = json_dump_file(root, path.c_str(), JSON_COMPACT) == 0;
+        json_decref(root);
+        return ok;
+}
+
+#endif
@@ -0,0 +1,170 @@
+#pragma once
+
+#include "plugin.hpp"
+
+// Counts the work done by each module to find which instance is expensive and why,
+// and traces the events of the last few thousand clock edges to find out when.
+//
+// Build with `make ORBITS_PROFILE=1` to enable, the counts are shown in the
+// Diagnostics submenu of the context menu which also saves the trace. Without
+// it the counters don't exist and the macros only evaluate their argument, so
+// a normal build is unchanged.
+
+#ifdef ORBITS_PROFILE
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+struct OrbitsProfile
+{
+        enum Counter
+        {
+                SAMPLES,
+                CLOCK_EDGES,
+                PATTERN_UPDATES,
+                RANDOMIZATIONS,
+                // Time stamp counter ticks spent in process and in the channels, only
+                // measured every timing_interval samples because reading the counter
+                // costs more than the rest of the profiling
+                PROCESS_TICKS,
+                CHANNEL_TICKS,
+                NUM_COUNTERS
+        };
+
+        static const uint64_t timing_interval = 64;
+
+        // Only the audio thread writes, the menu reads
+        std::atomic<uint64_t> m_counts[NUM_COUNTERS] = {};
+
+        void add(Counter counter, uint64_t n)
+        {
+                // A single writer doesn't need a locked read-modify-write
+                m_counts[counter].store(m_counts[counter].load(std::memory_order_relaxed) + n,
+                                        std::memory_order_relaxed);
+        }
+
+        uint64_t get(Counter counter) const
+        {
+                return m_counts[counter].load(std::memory_order_relaxed);
+        }
+
+        bool isTimedSample(void) const
+        {
+                return get(SAMPLES) % timing_interval == 0;
+        }
+
+        // Average ticks per sample of a tick counter
+        double perSample(Counter counter) const
+        {
+                uint64_t timed = get(SAMPLES) / timing_interval;
+                return timed ? (double)get(counter) / timed : 0.0;
+        }
+
+        void reset(void)
+        {
+                for(auto &count : m_counts)
+                {
+                        count.store(0, std::memory_order_relaxed);
+                }
+        }
+
+        static uint64_t now(void)
+        {
+#if defined(__x86_64__) || defined(__i386__)
+                return __rdtsc();
+#else
+                return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+        }
+};
+
+// Adds the ticks from construction to destruction to a counter on timed samples,
+// counted after SAMPLES so every scope in a sample agrees
+struct OrbitsProfileScope
+{
+        OrbitsProfile &m_profile;
+        OrbitsProfile::Counter m_counter;
+        bool m_timed;
+        uint64_t m_start;
+
+        OrbitsProfileScope(OrbitsProfile &profile, OrbitsProfile::Counter counter)
+                : m_profile(profile), m_counter(counter), m_timed(profile.isTimedSample()),
+                  m_start(m_timed ? OrbitsProfile::now() : 0)
+        {
+        }
+
+        ~OrbitsProfileScope()
+        {
+                if(m_timed)
+                {
+                        m_profile.add(m_counter, OrbitsProfile::now() - m_start);
+                }
+        }
+};
+
+struct OrbitsTraceEvent
+{
+        enum Type : uint8_t
+        {
+                CLOCK,
+                BEAT,
+                EOC,
+                SYNC,
+                RANDOMIZE,
+                PATTERN,
+                INPUT_MODE,
+                NUM_TYPES
+        };
+
+        // Engine frame the event happened on
+        int64_t frame;
+        Type type;
+        uint8_t channel;
+        // Meaning depends on the type, the step for clock edges, beats and end of cycles,
+        // the pattern word for pattern rebuilds and the new mode for input mode changes
+        uint32_t value;
+};
+
+// Fixed size ring of the latest events. Only the engine thread records, the UI
+// thread copies the ring without a lock and drops anything overwritten while it
+// was copying.
+struct OrbitsTrace
+{
+        static const uint32_t size = 4096;
+
+        OrbitsTraceEvent m_events[size];
+        // Number of events ever recorded, the next one goes at m_written % size
+        std::atomic<uint64_t> m_written{0};
+
+        void record(OrbitsTraceEvent::Type type, int64_t frame, int channel, uint32_t value)
+        {
+                uint64_t written = m_written.load(std::memory_order_relaxed);
+                m_events[written % size] = {frame, type, (uint8_t)channel, value};
+                m_written.store(written + 1, std::memory_order_release);
+        }
+
+        // Copies the events still in the ring, oldest first, into events and returns how many
+        uint32_t copy(OrbitsTraceEvent *events) const;
+
+        // Writes the events as Chrome trace JSON, for chrome://tracing or ui.perfetto.dev
+        bool save(const std::string &path, const std::string &name, float sample_rate) const;
+};
+
+#define ORBITS_PROFILE_ADD(profile, counter, n) (profile).add(OrbitsProfile::counter, (n))
+#define ORBITS_PROFILE_SCOPE(profile, counter) OrbitsProfileScope orbits_profile_scope((profile), OrbitsProfile::counter)
+#define ORBITS_TRACE(trace, type, frame, channel, value) (trace).record(OrbitsTraceEvent::type, (frame), (channel), (value))
+
+#else
+
+#define ORBITS_PROFILE_ADD(profile, counter, n) ((void)(n))
+#define ORBITS_PROFILE_SCOPE(profile, counter)
+#define ORBITS_TRACE(trace, type, frame, channel, value) do {} while(0)
+
+#endif
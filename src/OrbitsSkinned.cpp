@@ -4,6 +4,7 @@ OrbitsSkinnedKnob::OrbitsSkinnedKnob(OrbitsConfig *config, std::string component
 {
         m_config = config;
         m_component = component;
+        m_svgs = &config->getSvgs(component);
         minAngle = -0.83f * (float)M_PI;
         maxAngle = 0.83f * (float)M_PI;
         loadTheme(m_config->getDefaultThemeId());
@@ -11,7 +12,7 @@ OrbitsSkinnedKnob::OrbitsSkinnedKnob(OrbitsConfig *config, std::string component
 
 void OrbitsSkinnedKnob::loadTheme(int theme)
 {
-        setSvg(APP->window->loadSvg(m_config->getSvg(m_component, theme)));
+        setSvg((*m_svgs)[theme]);
         fb->dirty = true;
 }
 
@@ -24,12 +25,13 @@ OrbitsSkinnedScrew::OrbitsSkinnedScrew(OrbitsConfig *config, std::string compone
 {
         m_config = config;
         m_component = component;
+        m_svgs = &config->getSvgs(component);
         loadTheme(m_config->getDefaultThemeId());
 }
 
 void OrbitsSkinnedScrew::loadTheme(int theme)
 {
-        setSvg(APP->window->loadSvg(m_config->getSvg(m_component, theme)));
+        setSvg((*m_svgs)[theme]);
         fb->dirty = true;
 }
 
@@ -37,15 +39,17 @@ OrbitsSkinnedSwitch::OrbitsSkinnedSwitch(OrbitsConfig *config, std::string compo
 {
         m_config = config;
         m_component = component;
-        addFrame(APP->window->loadSvg(m_config->getSvg(m_component + "_off")));
-        addFrame(APP->window->loadSvg(m_config->getSvg(m_component + "_on")));
+        m_svgs = &config->getSvgs(component + "_off");
+        m_on_svgs = &config->getSvgs(component + "_on");
+        addFrame((*m_svgs)[config->getDefaultThemeId()]);
+        addFrame((*m_on_svgs)[config->getDefaultThemeId()]);
         shadow->opacity = 0.0;
 }
 
 void OrbitsSkinnedSwitch::loadTheme(int theme)
 {
-        frames[0] = APP->window->loadSvg(m_config->getSvg(m_component + "_off", theme));
-        frames[1] = APP->window->loadSvg(m_config->getSvg(m_component + "_on", theme));
+        frames[0] = (*m_svgs)[theme];
+        frames[1] = (*m_on_svgs)[theme];
 
         event::Change change;
         onChange(change);
@@ -62,13 +66,14 @@ OrbitsSkinnedPort::OrbitsSkinnedPort(OrbitsConfig *config, std::string component
 {
         m_config = config;
         m_component = component;
+        m_svgs = &config->getSvgs(component);
         loadTheme(m_config->getDefaultThemeId());
         shadow->opacity = 0.0f;
 }
 
 void OrbitsSkinnedPort::loadTheme(int theme)
 {
-        setSvg(APP->window->loadSvg(m_config->getSvg(m_component, theme)));
+        setSvg((*m_svgs)[theme]);
         // fb->dirty = true; // Already set by setSvg for SvgPorts
 }
 
@@ -8,6 +8,8 @@ struct OrbitsSkinned
 {
         OrbitsConfig *m_config;
         std::string m_component;
+        // The component's SVG in each theme, switching theme only swaps the handle
+        const std::vector<std::shared_ptr<window::Svg>> *m_svgs = NULL;
         virtual void loadTheme(int theme) = 0;
         virtual ~OrbitsSkinned() = 0;
 };
@@ -31,6 +33,8 @@ struct OrbitsSkinnedScrew : app::SvgScrew, OrbitsSkinned
 
 struct OrbitsSkinnedSwitch : app::SvgSwitch, OrbitsSkinned
 {
+        // m_svgs is the off frame
+        const std::vector<std::shared_ptr<window::Svg>> *m_on_svgs;
         OrbitsSkinnedSwitch(OrbitsConfig *config, std::string component);
         void loadTheme(int theme) override;
 };
@@ -1,6 +1,8 @@
 #include "OrbitsWidget.hpp"
 #include "OrbitsSkinned.hpp"
 
+#include <cstdio>
+
 OrbitsWidget::OrbitsWidget(OrbitsConfig *config)
 {
         m_config = config;
@@ -16,6 +18,11 @@ void OrbitsWidget::appendContextMenu(Menu *menu)
                 [=](int mode) {loadTheme(mode);}
         ));
 
+        menu->addChild(createIndexPtrSubmenuItem("Display Refresh",
+                OrbitsDisplayRate::getNames(),
+                &m_display_rate.m_index
+        ));
+
         appendModuleContextMenu(menu);
 }
 
@@ -35,16 +42,105 @@ void OrbitsWidget::loadTheme(int theme)
 {
         m_theme = theme;
 
-        for(auto child : children)
+        if(m_skinned.empty())
+        {
+                for(auto child : children)
+                {
+                        OrbitsSkinned *skinned = dynamic_cast<OrbitsSkinned *>(child);
+                        if(skinned)
+                        {
+                                m_skinned.push_back(skinned);
+                        }
+                }
+        }
+
+        for(OrbitsSkinned *skinned : m_skinned)
+        {
+                skinned->loadTheme(theme);
+        }
+
+        // Swap the background of the panel rather than replacing it
+        std::shared_ptr<window::Svg> svg = m_config->getSvgs("panel")[theme];
+        SvgPanel *panel = dynamic_cast<SvgPanel *>(getPanel());
+        if(panel)
+        {
+                panel->setBackground(svg);
+        }
+        else
+        {
+                setPanel(svg);
+        }
+}
+
+const char *orbitsNumberText(unsigned int number)
+{
+        static const struct Table
         {
-                OrbitsSkinned *skinned = dynamic_cast<OrbitsSkinned *>(child);
-                if(skinned)
+                char text[100][3];
+                Table()
                 {
-                        skinned->loadTheme(theme);
+                        for(unsigned int i = 0; i < 100; ++i)
+                        {
+                                std::snprintf(text[i], sizeof(text[i]), "%u", i);
+                        }
                 }
+        } table;
+        return number < 100 ? table.text[number] : "";
+}
+
+const std::string &orbitsDisplayFont(void)
+{
+        static const std::string path = asset::plugin(pluginInstance, "res/fonts/ShareTechMono-Regular.ttf");
+        return path;
+}
+
+static const double g_display_intervals[] = {0.0, 1.0 / 30.0, 1.0 / 15.0, 1.0 / 5.0};
+
+std::vector<std::string> OrbitsDisplayRate::getNames(void)
+{
+        return {"Every frame", "30 Hz", "15 Hz", "5 Hz"};
+}
+
+double OrbitsDisplayRate::getInterval(void) const
+{
+        return g_display_intervals[m_index];
+}
+
+bool OrbitsDisplayRefresh::update(uint32_t generation)
+{
+        if(generation == m_generation)
+        {
+                return false;
+        }
+
+        double now = system::getTime();
+        if(m_rate && now - m_time < m_rate->getInterval())
+        {
+                return false;
         }
 
-        setPanel(APP->window->loadSvg(m_config->getSvg("panel", theme)));
+        m_generation = generation;
+        m_time = now;
+        return true;
+}
+
+OrbitsDisplayBuffer::OrbitsDisplayBuffer(Vec size)
+{
+        box.size = size;
+}
+
+void OrbitsDisplayBuffer::draw(const DrawArgs &args)
+{
+        // Only shown on layer 1
+}
+
+void OrbitsDisplayBuffer::drawLayer(const DrawArgs &args, int layer)
+{
+        // Drawings to layer 1 don't dim when the room lights are dimmed
+        if(layer == 1)
+        {
+                FramebufferWidget::draw(args);
+        }
 }
 
 json_t *OrbitsWidget::dataToJson()
@@ -57,6 +153,7 @@ json_t *OrbitsWidget::dataToJson()
                 {
                         json_object_set_new(root, "theme", theme);
                 }
+                json_object_set_new(root, "display_refresh", json_integer(m_display_rate.m_index));
         }
         return root;
 }
@@ -70,6 +167,16 @@ void OrbitsWidget::dataFromJson(json_t *root)
                 {
                         loadTheme(json_string_value(obj));
                 }
+
+                obj = json_object_get(root, "display_refresh");
+                if(obj)
+                {
+                        int index = json_integer_value(obj);
+                        if(index >= 0 && index < (int)OrbitsDisplayRate::getNames().size())
+                        {
+                                m_display_rate.m_index = index;
+                        }
+                }
         }
 }
 
@@ -88,3 +195,221 @@ void BeatWidget::appendContextMenu(Menu *menu)
                 &m_module->m_mode
         ));
 }
+
+struct OrbitsMenuSlider : ui::Slider
+{
+        OrbitsMenuSlider(Quantity *q)
+        {
+                quantity = q;
+                box.size.x = 200.f;
+        }
+};
+
+void BusWidget::appendContextMenu(Menu *menu)
+{
+        OrbitsBusClient *bus = m_module;
+        menu->addChild(createSubmenuItem("Orbits Bus", "",
+                [=](Menu* menu) {
+                        menu->addChild(createMenuLabel("Follow the clock and sync of the bus leader"));
+                        menu->addChild(createCheckMenuItem("None", "",
+                                [=]() {return !bus->isConnected();},
+                                [=]() {bus->setBus(-1);}
+                        ));
+
+                        for(int i = 0; i < OrbitsBus::num_buses; ++i)
+                        {
+                                menu->addChild(createCheckMenuItem(string::f("Bus %d", i + 1), "",
+                                        [=]() {return bus->m_bus == i;},
+                                        [=]() {bus->setBus(i);}
+                                ));
+                        }
+
+                        menu->addChild(new MenuSeparator);
+                        menu->addChild(createCheckMenuItem("Lead", "",
+                                [=]() {return bus->isLeader();},
+                                [=]() {bus->setLeader(!bus->isLeader());},
+                                !bus->isConnected()
+                        ));
+                }
+        ));
+}
+
+void PresetWidget::refresh(void)
+{
+        m_cv->setList(OrbitsPresetIndex::get(m_module->model, m_decode));
+}
+
+void PresetWidget::appendContextMenu(Menu *menu)
+{
+        // Any presets saved or edited since the menu was last opened are parsed now
+        refresh();
+        std::shared_ptr<const OrbitsPresetList> list = m_cv->getList();
+        Module *module = m_module;
+        menu->addChild(createSubmenuItem("Preset Library", "",
+                [=](Menu* menu) {
+                        menu->addChild(createMenuLabel("Loaded from memory, the expander preset CV picks one"));
+                        int count = list->m_presets.size();
+                        for(int i = 0; i < count; ++i)
+                        {
+                                // Right hand side is the middle of the CV range that picks the preset
+                                std::shared_ptr<json_t> json = list->m_presets[i].m_json;
+                                menu->addChild(createMenuItem(list->m_presets[i].m_name,
+                                        string::f("%.2fV", (i + 0.5f) * 10.f / count),
+                                        [=]() {
+                                                history::ModuleChange *h = new history::ModuleChange;
+                                                h->name = "load preset";
+                                                h->moduleId = module->id;
+                                                h->oldModuleJ = module->toJson();
+                                                APP->engine->moduleFromJson(module, json.get());
+                                                h->newModuleJ = module->toJson();
+                                                APP->history->push(h);
+                                        },
+                                        !json
+                                ));
+                        }
+                }
+        ));
+}
+
+#ifdef ORBITS_PROFILE
+void DiagnosticsWidget::appendContextMenu(Menu *menu)
+{
+        OrbitsProfile *profile = m_profile;
+        OrbitsTrace *trace = m_trace;
+        OrbitsCapture *(*access)(Module *) = m_capture;
+        OrbitsCapture *capture = access(m_module);
+        Module *module = m_module;
+        menu->addChild(createSubmenuItem("Diagnostics", "",
+                [=](Menu* menu) {
+                        // A snapshot taken when the submenu opens
+                        unsigned long long samples = profile->get(OrbitsProfile::SAMPLES);
+                        menu->addChild(createMenuLabel(string::f("Samples: %llu", samples)));
+                        menu->addChild(createMenuLabel(string::f("Clock edges: %llu",
+                                (unsigned long long)profile->get(OrbitsProfile::CLOCK_EDGES))));
+                        menu->addChild(createMenuLabel(string::f("Pattern updates: %llu",
+                                (unsigned long long)profile->get(OrbitsProfile::PATTERN_UPDATES))));
+                        menu->addChild(createMenuLabel(string::f("Randomizations: %llu",
+                                (unsigned long long)profile->get(OrbitsProfile::RANDOMIZATIONS))));
+                        menu->addChild(createMenuLabel(string::f("Ticks per sample: %.1f",
+                                profile->perSample(OrbitsProfile::PROCESS_TICKS))));
+                        if(profile->get(OrbitsProfile::CHANNEL_TICKS))
+                        {
+                                menu->addChild(createMenuLabel(string::f("Channel ticks per sample: %.1f",
+                                        profile->perSample(OrbitsProfile::CHANNEL_TICKS))));
+                        }
+                        menu->addChild(new MenuSeparator);
+                        menu->addChild(createMenuItem("Reset counters", "", [=]() {profile->reset();}));
+
+                        std::string directory = asset::user("RareBreeds_Orbits");
+                        std::string name = string::f("%s-%lld", module->model->slug.c_str(), (long long)module->id);
+                        menu->addChild(new MenuSeparator);
+                        menu->addChild(createMenuLabel("Chrome trace JSON in the Rack user folder"));
+                        menu->addChild(createMenuItem("Save trace", "", [=]() {
+                                system::createDirectories(directory);
+                                std::string path = system::join(directory, "trace-" + name + ".json");
+                                if(trace->save(path, name, APP->engine->getSampleRate()))
+                                {
+                                        INFO("Saved trace to %s", path.c_str());
+                                }
+                                else
+                                {
+                                        WARN("Couldn't save trace to %s", path.c_str());
+                                }
+                        }));
+
+                        std::string path = system::join(directory, "capture-" + name + ".orbc");
+                        int state = capture->m_state.load();
+                        menu->addChild(new MenuSeparator);
+                        menu->addChild(createMenuLabel("Replays the saved recording and compares the outputs"));
+                        menu->addChild(createCheckMenuItem("Record inputs and outputs", "",
+                                [=]() {return state == OrbitsCapture::RECORDING;},
+                                [=]() {
+                                        if(state == OrbitsCapture::RECORDING)
+                                        {
+                                                capture->stop();
+                                        }
+                                        else
+                                        {
+                                                capture->start(module);
+                                        }
+                                }
+                        ));
+                        if(state == OrbitsCapture::STOPPED)
+                        {
+                                menu->addChild(createMenuLabel(string::f("Recorded %llu samples%s",
+                                        (unsigned long long)capture->m_samples, capture->m_full ? ", buffer full" : "")));
+                        }
+                        menu->addChild(createMenuItem("Save recording", "", [=]() {
+                                system::createDirectories(directory);
+                                if(capture->save(path))
+                                {
+                                        INFO("Saved recording to %s", path.c_str());
+                                }
+                                else
+                                {
+                                        WARN("Couldn't save recording to %s", path.c_str());
+                                }
+                        }, state != OrbitsCapture::STOPPED));
+                        menu->addChild(createMenuItem("Replay recording", "", [=]() {
+                                capture->m_replay_result = OrbitsCapture::replay(module->model, access, path);
+                                INFO("Replayed %s: %s", path.c_str(), capture->m_replay_result.c_str());
+                        }));
+                        if(!capture->m_replay_result.empty())
+                        {
+                                menu->addChild(createMenuLabel(capture->m_replay_result));
+                        }
+                }
+        ));
+}
+#endif
+
+void ClockWidget::appendContextMenu(Menu *menu)
+{
+        bool *enabled = m_enabled;
+        Quantity *tempo = m_tempo;
+        int *channels = m_channels;
+        menu->addChild(createSubmenuItem("Internal Clock", "",
+                [=](Menu* menu) {
+                        menu->addChild(createMenuLabel("A connected clock input syncs the internal clock"));
+                        menu->addChild(createBoolPtrMenuItem("Use internal clock", "", enabled));
+                        menu->addChild(new OrbitsMenuSlider(tempo));
+                        if(channels)
+                        {
+                                menu->addChild(createSubmenuItem("Channels", string::f("%d", *channels),
+                                        [=](Menu* menu) {
+                                                menu->addChild(createMenuLabel("Used without a clock cable"));
+                                                for(int i = 1; i <= PORT_MAX_CHANNELS; ++i)
+                                                {
+                                                        menu->addChild(createCheckMenuItem(string::f("%d", i), "",
+                                                                [=]() {return *channels == i;},
+                                                                [=]() {*channels = i;}
+                                                        ));
+                                                }
+                                        }
+                                ));
+                        }
+                }
+        ));
+}
+
+void SwingWidget::appendContextMenu(Menu *menu)
+{
+        menu->addChild(new OrbitsMenuSlider(m_quantity));
+        menu->addChild(createIndexPtrSubmenuItem("Swing Mode",
+                m_module->getOptions(),
+                &m_module->m_mode
+        ));
+}
+
+void AccentWidget::appendContextMenu(Menu *menu)
+{
+        menu->addChild(createIndexPtrSubmenuItem("Accent Mode",
+                m_module->getOptions(),
+                &m_module->m_mode
+        ));
+}
+
+void MorphWidget::appendContextMenu(Menu *menu)
+{
+        menu->addChild(new OrbitsMenuSlider(m_quantity));
+}
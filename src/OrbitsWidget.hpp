@@ -1,12 +1,43 @@
 #pragma once
 
+#include "OrbitsBus.hpp"
+#include "OrbitsCapture.hpp"
 #include "OrbitsConfig.hpp"
 #include "OrbitsModule.hpp"
+#include "OrbitsPresets.hpp"
+#include "OrbitsProfile.hpp"
+
+struct OrbitsSkinned;
+
+// Caps how often the displays of a module refresh, for large patches
+struct OrbitsDisplayRate
+{
+        // Index into getNames, the first doesn't cap the rate
+        int m_index = 0;
+
+        static std::vector<std::string> getNames(void);
+        // Shortest time between refreshes in seconds
+        double getInterval(void) const;
+};
+
+// Decides when a display reads its module again
+struct OrbitsDisplayRefresh
+{
+        const OrbitsDisplayRate *m_rate = NULL;
+        uint32_t m_generation = 0;
+        double m_time = 0.0;
+
+        // True if the display should read its module, generation is the module's display generation
+        bool update(uint32_t generation);
+};
 
 struct OrbitsWidget : ModuleWidget
 {
         int m_theme;
+        OrbitsDisplayRate m_display_rate;
         OrbitsConfig *m_config;
+        // Skinned children, found on the first theme change
+        std::vector<OrbitsSkinned *> m_skinned;
 
         OrbitsWidget(OrbitsConfig *config);
         void appendContextMenu(Menu *menu) override;
@@ -17,6 +48,20 @@ struct OrbitsWidget : ModuleWidget
         void dataFromJson(json_t *root);
 };
 
+// Text of the numbers shown on the displays, formatted once. Numbers of more than two digits are empty
+const char *orbitsNumberText(unsigned int number);
+
+// Path of the display font, built once. Rack caches the font itself by path
+const std::string &orbitsDisplayFont(void);
+
+// Caches the drawing of its children, shown on layer 1 so it doesn't dim with the room lights
+struct OrbitsDisplayBuffer : FramebufferWidget
+{
+        OrbitsDisplayBuffer(Vec size);
+        void draw(const DrawArgs &args) override;
+        void drawLayer(const DrawArgs &args, int layer) override;
+};
+
 struct EOCWidget
 {
         EOCMode *m_module;
@@ -28,3 +73,59 @@ struct BeatWidget
         BeatMode *m_module;
         void appendContextMenu(Menu *menu);
 };
+
+struct SwingWidget
+{
+        SwingMode *m_module;
+        Quantity *m_quantity;
+        void appendContextMenu(Menu *menu);
+};
+
+struct AccentWidget
+{
+        AccentMode *m_module;
+        void appendContextMenu(Menu *menu);
+};
+
+struct MorphWidget
+{
+        Quantity *m_quantity;
+        void appendContextMenu(Menu *menu);
+};
+
+struct ClockWidget
+{
+        bool *m_enabled;
+        Quantity *m_tempo;
+        // Channels clocked without a cable, NULL for modules with one channel
+        int *m_channels = NULL;
+        void appendContextMenu(Menu *menu);
+};
+
+struct PresetWidget
+{
+        Module *m_module;
+        OrbitsPresetCV *m_cv;
+        OrbitsPresetDecoder m_decode = NULL;
+        // Refreshes the preset index and gives the module the current list
+        void refresh(void);
+        void appendContextMenu(Menu *menu);
+};
+
+#ifdef ORBITS_PROFILE
+struct DiagnosticsWidget
+{
+        OrbitsProfile *m_profile;
+        OrbitsTrace *m_trace;
+        // The module's capture, replays use it to reach the capture of a fresh copy of the module
+        OrbitsCapture *(*m_capture)(Module *module);
+        Module *m_module;
+        void appendContextMenu(Menu *menu);
+};
+#endif
+
+struct BusWidget
+{
+        OrbitsBusClient *m_module;
+        void appendContextMenu(Menu *menu);
+};
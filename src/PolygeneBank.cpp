@@ -0,0 +1,5 @@
+#include "PolygeneBankModule.hpp"
+#include "PolygeneBankWidget.hpp"
+
+Model *modelRareBreeds_Orbits_PolygeneBank =
+        createModel<RareBreeds_Orbits_PolygeneBank, RareBreeds_Orbits_PolygeneBankWidget>("RareBreeds_Orbits_PolygeneBank");
@@ -0,0 +1,82 @@
+#include "PolygeneBankModule.hpp"
+
+RareBreeds_Orbits_PolygeneBank::RareBreeds_Orbits_PolygeneBank()
+{
+        config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
+
+        configOutput(BEAT_OUTPUT, "Beat");
+        configOutput(EOC_OUTPUT, "End of cycle");
+
+        leftExpander.producerMessage = &m_messages[0];
+        leftExpander.consumerMessage = &m_messages[1];
+}
+
+RareBreeds_Orbits_PolygeneBank *RareBreeds_Orbits_PolygeneBank::getBank(Module *module)
+{
+        Module *right = module->rightExpander.module;
+        if(right && right->model == modelRareBreeds_Orbits_PolygeneBank)
+        {
+                return static_cast<RareBreeds_Orbits_PolygeneBank *>(right);
+        }
+        return NULL;
+}
+
+bool RareBreeds_Orbits_PolygeneBank::isConnected(void)
+{
+        // Polygene is either directly on the left or on the other side of more banks
+        Module *left = leftExpander.module;
+        while(left && left->model == modelRareBreeds_Orbits_PolygeneBank)
+        {
+                left = left->leftExpander.module;
+        }
+        return left && left->model == modelRareBreeds_Orbits_Polygene;
+}
+
+void RareBreeds_Orbits_PolygeneBank::process(const ProcessArgs &args)
+{
+        // The message is left alone once Polygene is removed, don't keep outputting it
+        int channels = 0;
+        auto message = static_cast<const PolygeneBankMessage *>(leftExpander.consumerMessage);
+        if(isConnected())
+        {
+                channels = message->channels;
+        }
+
+        getOutput(BEAT_OUTPUT).setChannels(channels);
+        getOutput(EOC_OUTPUT).setChannels(channels);
+        getOutput(BEAT_OUTPUT).writeVoltages(message->beat);
+        getOutput(EOC_OUTPUT).writeVoltages(message->eoc);
+
+        OrbitsExpanderMessage *published = m_publisher.begin(this);
+        if(published)
+        {
+                published->channels = channels;
+                for(int i = 0; i < channels; ++i)
+                {
+                        published->channel[i] = message->state[i];
+                }
+                m_publisher.end(this);
+        }
+}
+
+json_t *RareBreeds_Orbits_PolygeneBank::dataToJson()
+{
+        json_t *root = json_object();
+        if(root)
+        {
+                json_object_set_new(root, "channels", json_integer(m_channels));
+        }
+        return root;
+}
+
+void RareBreeds_Orbits_PolygeneBank::dataFromJson(json_t *root)
+{
+        if(root)
+        {
+                json_t *obj = json_object_get(root, "channels");
+                if(obj)
+                {
+                        m_channels = math::clamp((int)json_integer_value(obj), 1, PORT_MAX_CHANNELS);
+                }
+        }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "OrbitsExpanderMessage.hpp"
+#include "plugin.hpp"
+
+// Sent from Polygene to each bank on its right every sample
+struct PolygeneBankMessage
+{
+        int channels;
+        float beat[PORT_MAX_CHANNELS];
+        float eoc[PORT_MAX_CHANNELS];
+        OrbitsExpanderChannel state[PORT_MAX_CHANNELS];
+};
+
+// Adds 16 more channels to the Polygene on its left, banks can be chained.
+// The channels are processed by Polygene, the bank only outputs them.
+struct RareBreeds_Orbits_PolygeneBank : Module
+{
+        enum ParamIds
+        {
+                NUM_PARAMS
+        };
+        enum InputIds
+        {
+                NUM_INPUTS
+        };
+        enum OutputIds
+        {
+                BEAT_OUTPUT,
+                EOC_OUTPUT,
+                NUM_OUTPUTS
+        };
+        enum LightIds
+        {
+                NUM_LIGHTS
+        };
+
+        // Number of channels this bank adds, read by Polygene
+        int m_channels = PORT_MAX_CHANNELS;
+        PolygeneBankMessage m_messages[2] = {};
+        OrbitsExpanderPublisher m_publisher;
+
+        RareBreeds_Orbits_PolygeneBank();
+        bool isConnected(void);
+        void process(const ProcessArgs &args) override;
+        json_t *dataToJson() override;
+        void dataFromJson(json_t *root) override;
+
+        // Returns the bank attached to the right of module, or NULL if there isn't one
+        static RareBreeds_Orbits_PolygeneBank *getBank(Module *module);
+};
@@ -0,0 +1,40 @@
+#include "PolygeneBankWidget.hpp"
+#include "OrbitsConfig.hpp"
+#include "OrbitsSkinned.hpp"
+#include "PolygeneBankModule.hpp"
+
+static OrbitsConfig g_config("res/polygene-bank-layout.json");
+
+RareBreeds_Orbits_PolygeneBankWidget::RareBreeds_Orbits_PolygeneBankWidget(RareBreeds_Orbits_PolygeneBank *module)
+        : OrbitsWidget(&g_config)
+{
+        setModule(module);
+
+        m_theme = m_config->getDefaultThemeId();
+
+        // clang-format off
+        setPanel(APP->window->loadSvg(m_config->getSvg("panel")));
+
+        addChild(createOrbitsSkinnedScrew(m_config, "screw_top_left", Vec(RACK_GRID_WIDTH + RACK_GRID_WIDTH / 2, RACK_GRID_WIDTH / 2)));
+        addChild(createOrbitsSkinnedScrew(m_config, "screw_bottom_right", Vec(box.size.x - RACK_GRID_WIDTH - RACK_GRID_WIDTH / 2, RACK_GRID_HEIGHT - RACK_GRID_WIDTH / 2)));
+
+        addOutput(createOrbitsSkinnedOutput(m_config, "beat_port", module, RareBreeds_Orbits_PolygeneBank::BEAT_OUTPUT));
+        addOutput(createOrbitsSkinnedOutput(m_config, "eoc_port", module, RareBreeds_Orbits_PolygeneBank::EOC_OUTPUT));
+        // clang-format on
+}
+
+void RareBreeds_Orbits_PolygeneBankWidget::appendModuleContextMenu(Menu *menu)
+{
+        RareBreeds_Orbits_PolygeneBank *bank = static_cast<RareBreeds_Orbits_PolygeneBank *>(module);
+
+        std::vector<std::string> labels;
+        for(int i = 1; i <= PORT_MAX_CHANNELS; ++i)
+        {
+                labels.push_back(std::to_string(i));
+        }
+
+        menu->addChild(createIndexSubmenuItem("Channels", labels,
+                [=]() {return bank->m_channels - 1;},
+                [=](size_t index) {bank->m_channels = index + 1;}
+        ));
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include "OrbitsWidget.hpp"
+
+struct RareBreeds_Orbits_PolygeneBank;
+
+struct RareBreeds_Orbits_PolygeneBankWidget : OrbitsWidget
+{
+        RareBreeds_Orbits_PolygeneBankWidget(RareBreeds_Orbits_PolygeneBank *module);
+        void appendModuleContextMenu(Menu *menu) override;
+};
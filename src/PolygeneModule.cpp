@@ -1,4 +1,6 @@
 #include "PolygeneModule.hpp"
+#include "ExpanderModule.hpp"
+#include "PolygeneBankModule.hpp"
 #include "PolygeneWidget.hpp"
 #include "Rhythm.hpp"
 
@@ -11,7 +13,7 @@ struct RandomizeChannelAction : rack::history::ModuleAction
                 RareBreeds_Orbits_Polygene* module = static_cast<RareBreeds_Orbits_Polygene *>(APP->engine->getModule(moduleId));
                 if (module)
                 {
-                        module->m_active_channel->m_state = old_state;
+                        module->m_active_channel->getState() = old_state;
                         module->syncParamsToActiveChannel();
                 }
         }
@@ -21,7 +23,7 @@ struct RandomizeChannelAction : rack::history::ModuleAction
                 RareBreeds_Orbits_Polygene* module = static_cast<RareBreeds_Orbits_Polygene *>(APP->engine->getModule(moduleId));
                 if (module)
                 {
-                        module->m_active_channel->m_state = new_state;
+                        module->m_active_channel->getState() = new_state;
                         module->syncParamsToActiveChannel();
                 }
         }
@@ -69,80 +71,175 @@ void RareBreeds_Orbits_Polygene::Channel::init(RareBreeds_Orbits_Polygene *modul
         m_current_step = 0;
         m_module = module;
         m_channel = channel;
-        m_state.length = m_module->getParam(LENGTH_KNOB_PARAM).getValue();
-        m_state.hits = m_module->getParam(HITS_KNOB_PARAM).getValue();
-        m_state.shift = m_module->getParam(SHIFT_KNOB_PARAM).getValue();
-        m_state.variation = m_module->getParam(VARIATION_KNOB_PARAM).getValue();
-        m_state.reverse = false;
-        m_state.invert = false;
+
+        PolygeneChannelState state;
+        state.length = m_module->getParam(LENGTH_KNOB_PARAM).getValue();
+        state.hits = m_module->getParam(HITS_KNOB_PARAM).getValue();
+        state.shift = m_module->getParam(SHIFT_KNOB_PARAM).getValue();
+        state.variation = m_module->getParam(VARIATION_KNOB_PARAM).getValue();
+        state.reverse = false;
+        state.invert = false;
+        state.swing = m_module->getParam(SWING_PARAM).getValue();
+        state.morph = m_module->getParam(MORPH_PARAM).getValue();
+        state.inner = -1;
+        state.ratio = default_clock_ratio;
+        for(auto &scene : m_module->m_scenes)
+        {
+                scene[m_channel] = state;
+        }
+
+        m_swing_delay.reset();
+        m_ratio_clock.reset();
+        m_lookahead.reset();
+        m_accent_level = 0.f;
+        m_published = {};
 }
 
 bool RareBreeds_Orbits_Polygene::Channel::readReverse(void)
 {
-        if(m_module->getInput(REVERSE_CV_INPUT).isConnected())
+        if(!isBankChannel() && m_module->getInput(REVERSE_CV_INPUT).isConnected())
         {
                 m_reverse_trigger.process(m_module->getInput(REVERSE_CV_INPUT).getPolyVoltage(m_channel));
                 return m_reverse_trigger.isHigh();
         }
         else
         {
-                return m_state.reverse;
+                return getState().reverse;
         }
 }
 
 bool RareBreeds_Orbits_Polygene::Channel::readInvert(void)
 {
-        if(m_module->getInput(INVERT_CV_INPUT).isConnected())
+        if(!isBankChannel() && m_module->getInput(INVERT_CV_INPUT).isConnected())
         {
                 m_invert_trigger.process(m_module->getInput(INVERT_CV_INPUT).getPolyVoltage(m_channel));
                 return m_invert_trigger.isHigh();
         }
         else
         {
-                return m_state.invert;
+                return getState().invert;
         }
 }
 
-bool RareBreeds_Orbits_Polygene::Channel::isOnBeat(unsigned int length, unsigned int hits, unsigned int shift,
-                                                   unsigned int variation, unsigned int beat, bool invert)
+bool RareBreeds_Orbits_Polygene::Channel::isInverted(void)
 {
-        return rhythm::nearEvenRhythmBeat(length, hits, variation, shift, beat) != invert;
+        if(!isBankChannel() && m_module->getInput(INVERT_CV_INPUT).isConnected())
+        {
+                return m_invert_trigger.isHigh();
+        }
+        else
+        {
+                return getState().invert;
+        }
 }
 
 unsigned int RareBreeds_Orbits_Polygene::Channel::readLength()
 {
         auto cv = m_module->getParameterizedVoltage(LENGTH_CV_INPUT, m_channel) / 5.f;
-        auto f_length = m_state.length + cv * (rhythm::max_length - 1);
-        return clampRounded(f_length, 1, rhythm::max_length);
+        auto f_length = getState().length + cv * (rhythm::max_length - 1);
+        auto length = clampRounded(f_length, 1, rhythm::max_length);
+
+        // Shortened while nesting so the inner pattern fits on every step
+        const PatternCache *inner = readInner();
+        return inner ? std::min(length, rhythm::maxOuterLength(inner->m_length)) : length;
 }
 
 unsigned int RareBreeds_Orbits_Polygene::Channel::readHits(unsigned int length)
 {
         auto cv = m_module->getParameterizedVoltage(HITS_CV_INPUT, m_channel) / 5.f;
-        auto f_hits = m_state.hits + cv;
+        auto f_hits = getState().hits + cv;
         return clampRounded(f_hits * length, 0, length);
 }
 
 unsigned int RareBreeds_Orbits_Polygene::Channel::readShift(unsigned int length)
 {
         auto cv = m_module->getParameterizedVoltage(SHIFT_CV_INPUT, m_channel) / 5.f;
-        auto f_shift = m_state.shift + cv * (rhythm::max_length - 1);
+        auto f_shift = getState().shift + cv * (rhythm::max_length - 1);
         return clampRounded(f_shift, 0, rhythm::max_length - 1) % length;
 }
 
 unsigned int RareBreeds_Orbits_Polygene::Channel::readVariation(unsigned int length, unsigned int hits)
 {
         auto cv = m_module->getParameterizedVoltage(VARIATION_CV_INPUT, m_channel) / 5.f;
-        auto f_variation = m_state.variation + cv;
+        auto f_variation = getState().variation + cv;
         auto count = rhythm::numNearEvenRhythms(length, hits);
         return clampRounded(f_variation * (count - 1), 0, count - 1);
 }
 
+float RareBreeds_Orbits_Polygene::Channel::readSwingOffset()
+{
+        // Per step offset from the expander, 1V is 10% of the clock period
+        if(m_module->m_expander.isAttached() && !isBankChannel())
+        {
+                return m_module->m_expander.getPolyVoltage(RareBreeds_Orbits_Expander::SWING_CV_INPUT, m_channel) / 10.f;
+        }
+        return 0.f;
+}
+
+bool RareBreeds_Orbits_Polygene::Channel::isMorphing()
+{
+        return m_module->m_expander.isAttached() && !isBankChannel() &&
+               m_module->m_expander.isConnected(RareBreeds_Orbits_Expander::MORPH_CV_INPUT);
+}
+
+float RareBreeds_Orbits_Polygene::Channel::readMorph()
+{
+        // 0V plays the rhythm, 10V plays the morph target
+        return m_module->m_expander.getPolyVoltage(RareBreeds_Orbits_Expander::MORPH_CV_INPUT, m_channel) / 10.f;
+}
+
+const PatternCache *RareBreeds_Orbits_Polygene::Channel::readInner()
+{
+        // The inner channel may not have been clocked yet
+        int inner = getState().inner;
+        if(inner >= 0 && inner != m_channel && m_module->m_channels[inner].m_pattern.m_length)
+        {
+                return &m_module->m_channels[inner].m_pattern;
+        }
+        return nullptr;
+}
+
+const PatternCache &RareBreeds_Orbits_Polygene::Channel::readPattern()
+{
+        const PatternCache *inner = readInner();
+        return inner ? m_nested.update(m_pattern, *inner) : m_pattern;
+}
+
 void RareBreeds_Orbits_Polygene::Channel::process(const ProcessArgs &args)
 {
         // A rising clock edge means first play the current beat
         // then advance to the next step
-        if(m_clock_trigger.process(m_module->getInput(CLOCK_INPUT).getPolyVoltage(m_channel)))
+        bool clock = m_clock_trigger.process(m_module->getInput(CLOCK_INPUT).getPolyVoltage(getPortChannel()));
+        float position = m_module->m_clock_positions[getPortChannel()];
+        if(m_module->m_internal_clock)
+        {
+                clock = m_ratio_clock.process(m_module->m_master_clock, clock_ratios[getState().ratio]);
+                position = m_ratio_clock.m_position;
+        }
+        if(m_module->m_bus.isConnected())
+        {
+                clock = m_module->m_bus_clock;
+                position = m_module->m_bus_position;
+        }
+        if(clock && m_module->m_precision)
+        {
+                m_module->m_edge_positions[m_channel] = position;
+        }
+        ORBITS_PROFILE_ADD(m_module->m_profile, CLOCK_EDGES, clock);
+        if(clock)
+        {
+                ORBITS_TRACE(m_module->m_trace, CLOCK, args.frame, m_channel, m_current_step);
+        }
+        m_swing_delay.step(clock);
+
+        // Between clocks only the morph follows its knob and CV
+        if(!clock && isMorphing())
+        {
+                auto target = clampRounded(getState().morph * m_morph.m_length, 0, m_morph.m_length);
+                m_pattern.followMorph(m_morph, target, readMorph());
+        }
+
+        if(clock)
         {
                 // Play the current beat
                 auto length = readLength();
@@ -152,6 +249,32 @@ void RareBreeds_Orbits_Polygene::Channel::process(const ProcessArgs &args)
                 auto variation = readVariation(length, hits);
                 auto reverse = readReverse();
 
+                if(isMorphing())
+                {
+                        auto target = clampRounded(getState().morph * length, 0, length);
+                        m_morph.update(length, hits, variation, target);
+                        m_pattern.morph(m_morph, readMorph(), shift, invert);
+                }
+                else
+                {
+                        bool changed = m_pattern.update(length, hits, shift, variation, invert);
+                        ORBITS_PROFILE_ADD(m_module->m_profile, PATTERN_UPDATES, changed);
+                        if(changed)
+                        {
+                                ORBITS_TRACE(m_module->m_trace, PATTERN, args.frame, m_channel, m_pattern.m_word);
+                        }
+                }
+
+                // A nested pattern is longer, it steps through the inner pattern for each step of this one
+                const PatternCache &pattern = readPattern();
+                length = pattern.m_length;
+
+                // The step comes from the count of clock edges on the bus
+                if(m_module->m_bus.isConnected())
+                {
+                        m_current_step = m_module->m_bus.getStep(length, reverse);
+                }
+
                 // Avoid stepping out of bounds
                 m_current_step = readStep(length);
 
@@ -169,9 +292,28 @@ void RareBreeds_Orbits_Polygene::Channel::process(const ProcessArgs &args)
 
                 unsigned int first = reverse ? length - 1 : 0;
                 unsigned int last = reverse ? 0 : length - 1;
-                m_eoc_generator.update(m_module->m_eoc, m_current_step == first, m_current_step == last);
+                bool eoc = m_eoc_generator.isEndOfCycle(m_module->m_eoc, m_current_step == first, m_current_step == last);
+                bool beat = pattern.beat(m_current_step);
+                m_analysis.update(pattern);
+                m_accent_table.update(m_module->m_accent, pattern);
+                if(beat)
+                {
+                        m_accent_level = m_accent_table.level(m_current_step);
+                }
+                m_lookahead.update(pattern, m_current_step, reverse, m_swing_delay.m_clock.getPeriod());
+
+                m_published.pattern = pattern.m_word;
+                m_published.step = m_current_step;
+                m_published.length = length;
+                m_published.on_beat = beat;
+                m_published.reverse = reverse;
+                if(m_current_step == last)
+                {
+                        ++m_published.cycles;
+                }
 
-                m_beat_generator.update(isOnBeat(length, hits, shift, variation, m_current_step, invert));
+                float delay = m_module->m_swing.delay(m_current_step, getState().swing, readSwingOffset());
+                m_swing_delay.schedule(delay, beat, eoc, m_beat_generator, m_eoc_generator);
 
                 if(!reverse)
                 {
@@ -186,98 +328,272 @@ void RareBreeds_Orbits_Polygene::Channel::process(const ProcessArgs &args)
                 }
         }
 
-        auto out = m_beat_generator.process(m_module->m_beat, args.sampleTime) ? 10.f : 0.f;
-        m_module->getOutput(BEAT_OUTPUT).setVoltage(out, m_channel);
+        m_swing_delay.process(m_beat_generator, m_eoc_generator);
+
+        bool beat = m_beat_generator.process(m_module->m_beat, args.sampleTime);
+        bool eoc = m_eoc_generator.process(args.sampleTime);
+#ifdef ORBITS_PROFILE
+        if(m_trace_beat.process(beat))
+        {
+                m_module->m_trace.record(OrbitsTraceEvent::BEAT, args.frame, m_channel, m_published.step);
+        }
+        if(m_trace_eoc.process(eoc))
+        {
+                m_module->m_trace.record(OrbitsTraceEvent::EOC, args.frame, m_channel, m_published.step);
+        }
+#endif
+        m_module->m_beat_voltages[m_channel] = beat ? 10.f : 0.f;
+        m_module->m_eoc_voltages[m_channel] = eoc ? 10.f : 0.f;
 
-        auto eoc_out = m_eoc_generator.process(args.sampleTime) ? 10.f : 0.f;
-        m_module->getOutput(EOC_OUTPUT).setVoltage(eoc_out, m_channel);
+        float ramp = m_lookahead.process();
+        if(m_module->m_expander.isAttached() && !isBankChannel())
+        {
+                m_module->m_expander.setNextBeat(m_channel, m_lookahead.m_steps, ramp);
+                m_module->m_expander.setAnalysis(m_channel, m_analysis.m_evenness, m_analysis.m_off_beatness,
+                                                  m_analysis.m_density, m_analysis.m_odd);
+                m_module->m_expander.setAccent(m_channel, m_accent_level);
+        }
 }
 
-json_t *RareBreeds_Orbits_Polygene::Channel::dataToJson()
+static json_t *channelStateToJson(const PolygeneChannelState &state)
 {
         json_t *root = json_object();
         if(root)
         {
-                json_object_set_new(root, "length", json_real(m_state.length));
-                json_object_set_new(root, "hits", json_real(m_state.hits));
-                json_object_set_new(root, "shift", json_real(m_state.shift));
-                json_object_set_new(root, "variation", json_real(m_state.variation));
-                json_object_set_new(root, "reverse", json_boolean(m_state.reverse));
-                json_object_set_new(root, "invert", json_boolean(m_state.invert));
+                json_object_set_new(root, "length", json_real(state.length));
+                json_object_set_new(root, "hits", json_real(state.hits));
+                json_object_set_new(root, "shift", json_real(state.shift));
+                json_object_set_new(root, "variation", json_real(state.variation));
+                json_object_set_new(root, "reverse", json_boolean(state.reverse));
+                json_object_set_new(root, "invert", json_boolean(state.invert));
+                json_object_set_new(root, "swing", json_real(state.swing));
+                json_object_set_new(root, "morph", json_real(state.morph));
+                json_object_set_new(root, "inner", json_integer(state.inner));
+                json_object_set_new(root, "ratio", json_integer(state.ratio));
         }
         return root;
 }
 
-void RareBreeds_Orbits_Polygene::Channel::dataFromJson(json_t *root)
+static void channelStateFromJson(json_t *root, PolygeneChannelState *state)
 {
         if(root)
         {
-                json_load_real(root, "length", &m_state.length);
-                json_load_real(root, "hits", &m_state.hits);
-                json_load_real(root, "shift", &m_state.shift);
-                json_load_real(root, "variation", &m_state.variation);
-                json_load_bool(root, "reverse", &m_state.reverse);
-                json_load_bool(root, "invert", &m_state.invert);
+                json_load_real(root, "length", &state->length);
+                json_load_real(root, "hits", &state->hits);
+                json_load_real(root, "shift", &state->shift);
+                json_load_real(root, "variation", &state->variation);
+                json_load_bool(root, "reverse", &state->reverse);
+                json_load_bool(root, "invert", &state->invert);
+                json_load_real(root, "swing", &state->swing);
+                json_load_real(root, "morph", &state->morph);
+                json_load_integer(root, "inner", &state->inner);
+                state->inner = math::clamp(state->inner, -1, RareBreeds_Orbits_Polygene::max_channels - 1);
+                json_load_integer(root, "ratio", &state->ratio);
+                state->ratio = math::clamp(state->ratio, 0, num_clock_ratios - 1);
         }
 }
 
+static json_t *sceneToJson(const PolygeneChannelState *scene, int channels)
+{
+        json_t *root = json_array();
+        if(root)
+        {
+                for(int i = 0; i < channels; ++i)
+                {
+                        json_t *channel_json = channelStateToJson(scene[i]);
+                        if(channel_json)
+                        {
+                                json_array_append_new(root, channel_json);
+                        }
+                }
+        }
+        return root;
+}
+
+static void sceneFromJson(json_t *root, PolygeneChannelState *scene, int channels)
+{
+        if(root)
+        {
+                for(int i = 0; i < channels; ++i)
+                {
+                        json_t *channel = json_array_get(root, i);
+                        if(channel)
+                        {
+                                channelStateFromJson(channel, &scene[i]);
+                        }
+                }
+        }
+}
+
+// Packed channel state, saved as base64 in "channel_state". Version 1 is the
+// version, the number of channels, a 16 bit mask of the saved scenes and then
+// every channel of each saved scene, packed_channel_size bytes each.
+static const uint8_t packed_state_version = 1;
+static const size_t packed_header_size = 4;
+static const size_t packed_channel_size = 6 * sizeof(float) + 3;
+
+static uint8_t *packChannelState(const PolygeneChannelState &state, uint8_t *p)
+{
+        const float values[6] = {state.length, state.hits, state.shift, state.variation, state.swing, state.morph};
+        std::memcpy(p, values, sizeof(values));
+        p += sizeof(values);
+        *p++ = state.reverse | state.invert << 1;
+        *p++ = (uint8_t)(int8_t)state.inner;
+        *p++ = (uint8_t)state.ratio;
+        return p;
+}
+
+static const uint8_t *unpackChannelState(const uint8_t *p, PolygeneChannelState *state)
+{
+        float values[6];
+        std::memcpy(values, p, sizeof(values));
+        p += sizeof(values);
+        state->length = values[0];
+        state->hits = values[1];
+        state->shift = values[2];
+        state->variation = values[3];
+        state->swing = values[4];
+        state->morph = values[5];
+        state->reverse = *p & 1;
+        state->invert = *p++ & 2;
+        state->inner = math::clamp((int)(int8_t)*p++, -1, RareBreeds_Orbits_Polygene::max_channels - 1);
+        state->ratio = math::clamp((int)*p++, 0, num_clock_ratios - 1);
+        return p;
+}
+
+// Calls visit(scene, channel, state) for every channel of the packed state, false if
+// it doesn't add up. Nothing is visited unless the whole of it can be read.
+template <typename Visit>
+static bool readPackedScenes(const std::vector<uint8_t> &packed, uint16_t *used, Visit visit)
+{
+        if(packed.size() < packed_header_size || packed[0] != packed_state_version)
+        {
+                return false;
+        }
+        int channels = packed[1];
+        *used = packed[2] | packed[3] << 8;
+        if(packed.size() != packed_header_size + __builtin_popcount(*used) * channels * packed_channel_size)
+        {
+                return false;
+        }
+
+        const uint8_t *p = packed.data() + packed_header_size;
+        for(int i = 0; i < RareBreeds_Orbits_Polygene::num_scenes; ++i)
+        {
+                if(*used & (1 << i))
+                {
+                        // Channels past max_channels are skipped
+                        for(int c = 0; c < channels; ++c)
+                        {
+                                PolygeneChannelState state;
+                                p = unpackChannelState(p, &state);
+                                if(c < RareBreeds_Orbits_Polygene::max_channels)
+                                {
+                                        visit(i, c, state);
+                                }
+                        }
+                }
+        }
+        return true;
+}
+
+// The channels a preset loads into the active scene, for the expander preset CV
+struct PolygenePresetState : OrbitsPresetState
+{
+        std::vector<PolygeneChannelState> m_channels;
+};
+
 void RareBreeds_Orbits_Polygene::Channel::onRandomizeWithHistory(int randomization_mask)
 {
+#ifdef ORBITS_PROFILE
+        // A replay runs on a copy of the module outside the patch, there's nothing to undo
+        if(m_module->m_capture.isReplaying())
+        {
+                onRandomize(randomization_mask);
+                return;
+        }
+#endif
+
         RandomizeChannelAction* action = new RandomizeChannelAction;
         action->moduleId = m_module->id;
-        action->old_state = m_state;
+        action->old_state = getState();
         onRandomize(randomization_mask);
-        action->new_state = m_state;
+        action->new_state = getState();
         APP->history->push(action);
 }
 
 void RareBreeds_Orbits_Polygene::Channel::onRandomize(int randomization_mask)
 {
+        ORBITS_PROFILE_ADD(m_module->m_profile, RANDOMIZATIONS, 1);
+        ORBITS_TRACE(m_module->m_trace, RANDOMIZE, APP->engine->getFrame(), m_channel, randomization_mask);
+
         if (randomization_mask & (1 << RANDOMIZE_LENGTH))
         {
-                m_state.length = random::uniform() * rhythm::max_length;
+                getState().length = ORBITS_UNIFORM(m_module->m_capture) * rhythm::max_length;
         }
 
         if (randomization_mask & (1 << RANDOMIZE_HITS))
         {
-                m_state.hits = random::uniform();
+                getState().hits = ORBITS_UNIFORM(m_module->m_capture);
         }
 
         if (randomization_mask & (1 << RANDOMIZE_SHIFT))
         {
-                m_state.shift = random::uniform() * (rhythm::max_length - 1);
+                getState().shift = ORBITS_UNIFORM(m_module->m_capture) * (rhythm::max_length - 1);
         }
 
         if (randomization_mask & (1 << RANDOMIZE_VARIATION))
         {
-                m_state.variation = random::uniform();
+                getState().variation = ORBITS_UNIFORM(m_module->m_capture);
         }
 
         if (randomization_mask & (1 << RANDOMIZE_REVERSE))
         {
-                m_state.reverse = (random::uniform() < 0.5f);
+                getState().reverse = (ORBITS_UNIFORM(m_module->m_capture) < 0.5f);
         }
 
         if (randomization_mask & (1 << RANDOMIZE_INVERT))
         {
-                m_state.invert = (random::uniform() < 0.5f);
+                getState().invert = (ORBITS_UNIFORM(m_module->m_capture) < 0.5f);
         }
 }
 
 PolygeneDisplayData RareBreeds_Orbits_Polygene::getDisplayData(void)
 {
+        // Show the bank containing the active channel
+        int bank = m_active_channel_id / PORT_MAX_CHANNELS;
+        Channel *channels = &m_channels[bank * PORT_MAX_CHANNELS];
+
         PolygeneDisplayData data;
-        data.active_channel_id = m_active_channel_id;
-        data.active_channels = m_active_channels;
+        data.active_channel_id = m_active_channel_id % PORT_MAX_CHANNELS;
+        data.active_channels = m_bank_channels[bank];
+        data.first_channel = bank * PORT_MAX_CHANNELS + 1;
         for(int c = 0; c < PORT_MAX_CHANNELS; ++c)
         {
                 auto ch = &data.channels[c];
-                ch->length = m_channels[c].readLength();
-                ch->hits = m_channels[c].readHits(ch->length);
-                ch->shift = m_channels[c].readShift(ch->length);
-                ch->variation = m_channels[c].readVariation(ch->length, ch->hits);
-                ch->invert = m_channels[c].readInvert();
-                ch->current_step = m_channels[c].readStep(ch->length);
+                const PatternCache &playing = channels[c].m_pattern;
+                if(playing.m_morphed && channels[c].isMorphing())
+                {
+                        // The morphed pattern playing, hits are counted before it's shifted and inverted
+                        ch->length = playing.m_length;
+                        ch->hits = __builtin_popcount(channels[c].m_morph.at(playing.m_position));
+                        ch->shift = playing.m_shift;
+                        ch->variation = channels[c].m_morph.m_variation;
+                        ch->invert = playing.m_invert;
+                        ch->pattern = playing.m_word;
+                }
+                else
+                {
+                        ch->length = channels[c].readLength();
+                        ch->hits = channels[c].readHits(ch->length);
+                        ch->shift = channels[c].readShift(ch->length);
+                        ch->variation = channels[c].readVariation(ch->length, ch->hits);
+                        ch->invert = channels[c].isInverted();
+                        PatternCache pattern;
+                        pattern.update(ch->length, ch->hits, ch->shift, ch->variation, ch->invert);
+                        ch->pattern = pattern.m_word;
+                }
+                ch->current_step = channels[c].readStep(ch->length);
         }
         return data;
 }
@@ -286,12 +602,12 @@ PolygeneDisplayData RareBreeds_Orbits_Polygene::getDisplayData(RareBreeds_Orbits
 {
         if(module)
         {
-                return module->getDisplayData();
+                return module->m_display.read();
         }
         else
         {
                 // Default data shown in the module browser
-                PolygeneDisplayData data = {3, PORT_MAX_CHANNELS,
+                PolygeneDisplayData data = {3, PORT_MAX_CHANNELS, 1,
                         {{32, 6, 0, 0, 0, 4},
                         {16, 9, 3, 0, 0, 0},
                         {7, 3, 6, 0, 0, 5},
@@ -308,6 +624,12 @@ PolygeneDisplayData RareBreeds_Orbits_Polygene::getDisplayData(RareBreeds_Orbits
                         {28, 14, 6, 0, 0, 20},
                         {21, 12, 4, 0, 0, 4},
                         {9, 3, 3, 0, 0, 7}}};
+                for(auto &ch : data.channels)
+                {
+                        PatternCache pattern;
+                        pattern.update(ch.length, ch.hits, ch.shift, ch.variation, ch.invert);
+                        ch.pattern = pattern.m_word;
+                }
                 return data;
         }
 }
@@ -325,6 +647,9 @@ RareBreeds_Orbits_Polygene::RareBreeds_Orbits_Polygene()
         configSwitch(INVERT_KNOB_PARAM, 0.f, 1.f, 0.f, "Invert", {"Off", "On"});
         configButton(RANDOM_KNOB_PARAM, "Randomize channel");
         configButton(SYNC_KNOB_PARAM, "Sync");
+        configParam(SWING_PARAM, 0.f, 0.5f, 0.f, "Swing", "% of clock period", 0.f, 100.f);
+        configParam(MORPH_PARAM, 0.f, 1.f, 0.f, "Morph target hits", "%", 0.f, 100.f);
+        configParam(TEMPO_PARAM, -2.f, 2.f, 0.f, "Internal clock tempo", " BPM", 2.f, 120.f);
 
         configInput(CLOCK_INPUT, "Clock");
         configInput(SYNC_INPUT, "Sync");
@@ -341,6 +666,8 @@ RareBreeds_Orbits_Polygene::RareBreeds_Orbits_Polygene()
 
         configBypass(CLOCK_INPUT, BEAT_OUTPUT);
 
+        m_expander.init(this);
+
         for(int i = 0; i < NUM_INPUTS; ++i)
         {
                 m_input_mode[i] = INPUT_MODE_MONOPHONIC_COPIES_TO_ALL;
@@ -351,24 +678,36 @@ RareBreeds_Orbits_Polygene::RareBreeds_Orbits_Polygene()
 
 void RareBreeds_Orbits_Polygene::reset()
 {
-        m_previous_channel_id = PORT_MAX_CHANNELS;
+        m_scene = 0;
+        m_selected_scene = 0;
+        for(int i = 0; i < num_scenes; ++i)
+        {
+                m_scene_used[i] = i == m_scene;
+        }
+
+        m_previous_channel_id = max_channels;
         m_active_channel_id = 0;
         m_active_channel = &m_channels[m_active_channel_id];
 
-        for(auto i = 0u; i < PORT_MAX_CHANNELS; ++i)
+        for(auto i = 0; i < max_channels; ++i)
         {
                 m_channels[i].init(this, i);
         }
+
+        m_master_clock.reset();
+        m_bus_ratio_clock.reset();
 }
 
 void RareBreeds_Orbits_Polygene::syncParamsToActiveChannel()
 {
-        getParam(LENGTH_KNOB_PARAM).setValue(m_active_channel->m_state.length);
-        getParam(HITS_KNOB_PARAM).setValue(m_active_channel->m_state.hits);
-        getParam(SHIFT_KNOB_PARAM).setValue(m_active_channel->m_state.shift);
-        getParam(VARIATION_KNOB_PARAM).setValue(m_active_channel->m_state.variation);
-        getParam(REVERSE_KNOB_PARAM).setValue(m_active_channel->m_state.reverse);
-        getParam(INVERT_KNOB_PARAM).setValue(m_active_channel->m_state.invert);
+        getParam(LENGTH_KNOB_PARAM).setValue(m_active_channel->getState().length);
+        getParam(HITS_KNOB_PARAM).setValue(m_active_channel->getState().hits);
+        getParam(SHIFT_KNOB_PARAM).setValue(m_active_channel->getState().shift);
+        getParam(VARIATION_KNOB_PARAM).setValue(m_active_channel->getState().variation);
+        getParam(REVERSE_KNOB_PARAM).setValue(m_active_channel->getState().reverse);
+        getParam(INVERT_KNOB_PARAM).setValue(m_active_channel->getState().invert);
+        getParam(SWING_PARAM).setValue(m_active_channel->getState().swing);
+        getParam(MORPH_PARAM).setValue(m_active_channel->getState().morph);
 }
 
 InputMode RareBreeds_Orbits_Polygene::getInputMode(int input_id)
@@ -378,6 +717,11 @@ InputMode RareBreeds_Orbits_Polygene::getInputMode(int input_id)
 
 float RareBreeds_Orbits_Polygene::getParameterizedVoltage(int input_id, int channel)
 {
+        if(channel >= PORT_MAX_CHANNELS)
+        {
+                return 0.f;
+        }
+
         Input input = getInput(input_id);
         switch(getInputMode(input_id))
         {
@@ -389,13 +733,163 @@ float RareBreeds_Orbits_Polygene::getParameterizedVoltage(int input_id, int chan
         }
 }
 
-void RareBreeds_Orbits_Polygene::process(const ProcessArgs &args)
+void RareBreeds_Orbits_Polygene::findBanks()
 {
         m_active_channels = getInput(CLOCK_INPUT).getChannels();
+        if(m_internal_clock && m_active_channels == 0)
+        {
+                // The internal clock doesn't need a clock cable, the channel count comes from the context menu
+                m_active_channels = m_internal_channels;
+        }
+        if(m_bus.isConnected() && m_active_channels == 0)
+        {
+                // Following a bus doesn't need a clock cable
+                m_active_channels = 1;
+        }
+        m_bank_channels[0] = m_active_channels;
+        m_banks = 1;
+
+        RareBreeds_Orbits_PolygeneBank *bank = RareBreeds_Orbits_PolygeneBank::getBank(this);
+        while(bank && m_banks < max_banks)
+        {
+                m_bank_modules[m_banks] = bank;
+                // Banks follow the clock, they're silent until it's connected
+                m_bank_channels[m_banks] = m_active_channels ? bank->m_channels : 0;
+                ++m_banks;
+                bank = RareBreeds_Orbits_PolygeneBank::getBank(bank);
+        }
+
+        for(int b = m_banks; b < max_banks; ++b)
+        {
+                m_bank_modules[b] = NULL;
+                m_bank_channels[b] = 0;
+        }
+}
+
+void RareBreeds_Orbits_Polygene::processBanks()
+{
+        // Voltages are copied as a block per bank, the rhythm state channel by channel
+        for(int b = 1; b < m_banks; ++b)
+        {
+                RareBreeds_Orbits_PolygeneBank *bank = m_bank_modules[b];
+                int first = b * PORT_MAX_CHANNELS;
+
+                auto message = static_cast<PolygeneBankMessage *>(bank->leftExpander.producerMessage);
+                message->channels = m_bank_channels[b];
+                std::copy(&m_beat_voltages[first], &m_beat_voltages[first + PORT_MAX_CHANNELS], message->beat);
+                std::copy(&m_eoc_voltages[first], &m_eoc_voltages[first + PORT_MAX_CHANNELS], message->eoc);
+                for(int i = 0; i < m_bank_channels[b]; ++i)
+                {
+                        message->state[i] = m_channels[first + i].m_published;
+                }
+                bank->leftExpander.messageFlipRequested = true;
+        }
+}
+
+int RareBreeds_Orbits_Polygene::readScene()
+{
+        if(m_expander.isAttached() && m_expander.isConnected(RareBreeds_Orbits_Expander::SCENE_CV_INPUT))
+        {
+                // 0V to 10V covers every scene
+                float cv = m_expander.getVoltage(RareBreeds_Orbits_Expander::SCENE_CV_INPUT);
+                return math::clamp((int)(cv / 10.f * num_scenes), 0, num_scenes - 1);
+        }
+
+        return m_selected_scene;
+}
+
+void RareBreeds_Orbits_Polygene::processScene()
+{
+        // The first channel completing a cycle is the end of cycle for switching scenes
+        uint32_t cycles = m_channels[0].m_published.cycles;
+        bool eoc = cycles != m_scene_cycles;
+        m_scene_cycles = cycles;
+
+        int scene = readScene();
+        if(scene != m_scene && (!m_scene_on_eoc || eoc))
+        {
+                m_scene = scene;
+                m_scene_used[scene] = true;
+
+                // Move the knobs to the active channel of the new scene
+                m_previous_channel_id = max_channels;
+        }
+}
+
+void RareBreeds_Orbits_Polygene::processPreset()
+{
+        bool connected = m_expander.isAttached() && m_expander.isConnected(RareBreeds_Orbits_Expander::PRESET_CV_INPUT);
+        float cv = connected ? m_expander.getVoltage(RareBreeds_Orbits_Expander::PRESET_CV_INPUT) : 0.f;
+        const OrbitsPreset *preset = m_preset.process(connected, cv);
+        if(preset)
+        {
+                preset->applyParams(this);
+                const PolygenePresetState *state = static_cast<const PolygenePresetState *>(preset->m_state.get());
+                if(state)
+                {
+                        std::copy(state->m_channels.begin(), state->m_channels.end(), m_scenes[m_scene]);
+
+                        // Move the knobs to the active channel's new settings
+                        m_previous_channel_id = max_channels;
+                }
+        }
+}
+
+void RareBreeds_Orbits_Polygene::copyScene(int from, int to)
+{
+        if(from != to)
+        {
+                std::copy(m_scenes[from], m_scenes[from] + max_channels, m_scenes[to]);
+                m_scene_used[to] = true;
+        }
+}
+
+float RareBreeds_Orbits_Polygene::readTempo()
+{
+        // Beats per second, the expander CV adds 1V per octave like Rack's clock modules
+        float octaves = getParam(TEMPO_PARAM).getValue();
+        if(m_expander.isAttached())
+        {
+                octaves += m_expander.getVoltage(RareBreeds_Orbits_Expander::TEMPO_CV_INPUT);
+        }
+        return 2.f * std::exp2(math::clamp(octaves, -5.f, 5.f));
+}
+
+void RareBreeds_Orbits_Polygene::findEdgePositions()
+{
+        // Where each clock channel crossed the trigger threshold, 4 channels at a time
+        for(int c = 0; c < PORT_MAX_CHANNELS; c += 4)
+        {
+                simd::float_4 current = getInput(CLOCK_INPUT).getPolyVoltageSimd<simd::float_4>(c);
+                simd::float_4 previous = simd::float_4::load(&m_clock_voltages[c]);
+                crossingPosition(previous, current, 1.f).store(&m_clock_positions[c]);
+                current.store(&m_clock_voltages[c]);
+        }
+}
+
+void RareBreeds_Orbits_Polygene::process(const ProcessArgs &args)
+{
+        ORBITS_CAPTURE(m_capture, this, args);
+        ORBITS_PROFILE_ADD(m_profile, SAMPLES, 1);
+        ORBITS_PROFILE_SCOPE(m_profile, PROCESS_TICKS);
+
+        findBanks();
         getOutput(BEAT_OUTPUT).setChannels(m_active_channels);
         getOutput(EOC_OUTPUT).setChannels(m_active_channels);
 
-        m_active_channel_id = (int)std::round(getParam(CHANNEL_KNOB_PARAM).getValue());
+        m_expander.process(this);
+        if(m_expander.isAttached())
+        {
+                m_expander.setChannels(m_active_channels);
+        }
+
+        processScene();
+        processPreset();
+        m_display.process([this]() {return getDisplayData();});
+
+        // Fall back to the last bank attached when the selected bank has been removed
+        int bank = std::min(m_bank, m_banks - 1);
+        m_active_channel_id = bank * PORT_MAX_CHANNELS + (int)std::round(getParam(CHANNEL_KNOB_PARAM).getValue());
         m_active_channel = &m_channels[m_active_channel_id];
 
         // Update the knob positions when the channel changes
@@ -405,16 +899,18 @@ void RareBreeds_Orbits_Polygene::process(const ProcessArgs &args)
                 m_previous_channel_id = m_active_channel_id;
         }
 
-        m_active_channel->m_state.length = getParam(LENGTH_KNOB_PARAM).getValue();
-        m_active_channel->m_state.hits = getParam(HITS_KNOB_PARAM).getValue();
-        m_active_channel->m_state.shift = getParam(SHIFT_KNOB_PARAM).getValue();
-        m_active_channel->m_state.variation = getParam(VARIATION_KNOB_PARAM).getValue();
+        m_active_channel->getState().length = getParam(LENGTH_KNOB_PARAM).getValue();
+        m_active_channel->getState().hits = getParam(HITS_KNOB_PARAM).getValue();
+        m_active_channel->getState().shift = getParam(SHIFT_KNOB_PARAM).getValue();
+        m_active_channel->getState().variation = getParam(VARIATION_KNOB_PARAM).getValue();
+        m_active_channel->getState().swing = getParam(SWING_PARAM).getValue();
+        m_active_channel->getState().morph = getParam(MORPH_PARAM).getValue();
 
         m_reverse_trigger.process(getParam(REVERSE_KNOB_PARAM).getValue() > 0.5f);
-        m_active_channel->m_state.reverse = m_reverse_trigger.state;
+        m_active_channel->getState().reverse = m_reverse_trigger.state;
 
         m_invert_trigger.process(getParam(INVERT_KNOB_PARAM).getValue() > 0.5f);
-        m_active_channel->m_state.invert = m_invert_trigger.state;
+        m_active_channel->getState().invert = m_invert_trigger.state;
 
         bool rnd = getParam(RANDOM_KNOB_PARAM).getValue() > 0.5f;
         if(m_random_trigger.process(rnd, args.sampleTime))
@@ -432,29 +928,222 @@ void RareBreeds_Orbits_Polygene::process(const ProcessArgs &args)
                 }
         }
 
-        for(int i = 0; i < PORT_MAX_CHANNELS; ++i)
+        bool first_synced = false;
+        for(int i = 0; i < max_channels; ++i)
         {
-                if(m_channels[i].m_sync_trigger.process(getParameterizedVoltage(SYNC_INPUT, i)))
+                // Channels on banks are synced along with the matching Polygene channel
+                float sync = getParameterizedVoltage(SYNC_INPUT, m_channels[i].getPortChannel());
+                if(m_channels[i].m_sync_trigger.process(sync))
                 {
+                        ORBITS_TRACE(m_trace, SYNC, args.frame, i, 0);
                         m_channels[i].m_current_step = 0;
+                        first_synced = first_synced || i == 0;
+                }
+        }
+
+        if(m_precision)
+        {
+                findEdgePositions();
+        }
+
+        if(m_internal_clock)
+        {
+                // The first clock channel syncs the internal clock instead of stepping the channels
+                if(getInput(CLOCK_INPUT).isConnected())
+                {
+                        bool edge = m_external_clock_trigger.process(getInput(CLOCK_INPUT).getVoltage(0));
+                        m_master_clock.processExternal(edge);
+                }
+                else
+                {
+                        m_master_clock.process(readTempo(), args.sampleTime);
+                }
+        }
+
+        bool sync = m_sync_trigger.process(getParam(SYNC_KNOB_PARAM).getValue() > 0.5f);
+        if(m_bus.isConnected())
+        {
+                // Every channel follows the clock and sync of the bus leader,
+                // when leading Polygene publishes the clock and sync of its first channel
+                m_bus_clock = m_bus_clock_trigger.process(getInput(CLOCK_INPUT).getVoltage(0));
+                m_bus_position = m_clock_positions[0];
+                if(m_internal_clock)
+                {
+                        m_bus_clock = m_bus_ratio_clock.process(m_master_clock, clock_ratios[default_clock_ratio]);
+                        m_bus_position = m_bus_ratio_clock.m_position;
+                }
+                sync = sync || first_synced;
+                m_bus.process(args.frame, &m_bus_clock, &sync);
+
+                // The leader's clock edge isn't known to followers, they place the steps on the sample
+                if(!m_bus.isLeader())
+                {
+                        m_bus_position = 0.f;
                 }
         }
 
-        if(m_sync_trigger.process(getParam(SYNC_KNOB_PARAM).getValue() > 0.5f))
+        if(sync)
         {
+                ORBITS_TRACE(m_trace, SYNC, args.frame, 0, 0);
                 for(auto &chan : m_channels)
                 {
                         chan.m_current_step = 0;
                 }
         }
 
-        int clock_channels = getInput(CLOCK_INPUT).getChannels();
-        for(int i = 0; i < clock_channels; ++i)
+#ifdef ORBITS_PROFILE
+        for(int i = 0; i < NUM_INPUTS; ++i)
+        {
+                if(m_input_mode[i] != m_trace_input_mode[i])
+                {
+                        // The channel of an input mode change is the input
+                        m_trace.record(OrbitsTraceEvent::INPUT_MODE, args.frame, i, m_input_mode[i]);
+                        m_trace_input_mode[i] = m_input_mode[i];
+                }
+        }
+#endif
+
+        // Each channel's rhythm is worked out one channel at a time, bank channels follow on
+        // in the same array. Only the voltages are laid out for blocks of channels: each
+        // channel writes its own slot of the flat voltage arrays, which the precision outputs,
+        // the outputs and the bank messages then read 4 or 16 channels at a time.
+        {
+                ORBITS_PROFILE_SCOPE(m_profile, CHANNEL_TICKS);
+                for(int b = 0; b < m_banks; ++b)
+                {
+                        Channel *channels = &m_channels[b * PORT_MAX_CHANNELS];
+                        for(int i = 0; i < m_bank_channels[b]; ++i)
+                        {
+                                channels[i].process(args);
+                        }
+                }
+        }
+
+        if(m_precision)
+        {
+                // Bank channels follow on in the same arrays so they're band limited along with the rest
+                m_precision_beat.process(m_beat_voltages, m_edge_positions, m_banks * PORT_MAX_CHANNELS);
+                m_precision_eoc.process(m_eoc_voltages, m_edge_positions, m_banks * PORT_MAX_CHANNELS);
+        }
+
+        getOutput(BEAT_OUTPUT).writeVoltages(m_beat_voltages);
+        getOutput(EOC_OUTPUT).writeVoltages(m_eoc_voltages);
+        processBanks();
+
+        publish();
+}
+
+void RareBreeds_Orbits_Polygene::processBypass(const ProcessArgs &args)
+{
+        // The display keeps following the channels while bypassed
+        m_display.process([this]() {return getDisplayData();});
+        Module::processBypass(args);
+}
+
+void RareBreeds_Orbits_Polygene::publish()
+{
+        OrbitsExpanderMessage *message = m_publisher.begin(this);
+        if(message)
         {
-                m_channels[i].process(args);
+                message->channels = m_active_channels;
+                for(int i = 0; i < m_active_channels; ++i)
+                {
+                        message->channel[i] = m_channels[i].m_published;
+                }
+                m_publisher.end(this);
         }
 }
 
+std::string RareBreeds_Orbits_Polygene::packScenes(void)
+{
+        uint16_t used = 0;
+        for(int i = 0; i < num_scenes; ++i)
+        {
+                if(i == m_scene || m_scene_used[i])
+                {
+                        used |= 1 << i;
+                }
+        }
+
+        std::vector<uint8_t> packed(packed_header_size +
+                                    __builtin_popcount(used) * max_channels * packed_channel_size);
+        uint8_t *p = packed.data();
+        *p++ = packed_state_version;
+        *p++ = max_channels;
+        *p++ = used & 0xff;
+        *p++ = used >> 8;
+        for(int i = 0; i < num_scenes; ++i)
+        {
+                if(used & (1 << i))
+                {
+                        for(int c = 0; c < max_channels; ++c)
+                        {
+                                p = packChannelState(m_scenes[i][c], p);
+                        }
+                }
+        }
+        return encodeBase64(packed.data(), packed.size());
+}
+
+bool RareBreeds_Orbits_Polygene::unpackScenes(const char *base64, size_t length)
+{
+        // Anything that doesn't add up falls back to the JSON channels
+        uint16_t used;
+        if(!decodeBase64(base64, length, &m_packed_scenes) ||
+           !readPackedScenes(m_packed_scenes, &used, [this](int scene, int channel, const PolygeneChannelState &state) {
+                   m_scenes[scene][channel] = state;
+           }))
+        {
+                return false;
+        }
+
+        for(int i = 0; i < num_scenes; ++i)
+        {
+                m_scene_used[i] = used & (1 << i);
+        }
+        m_scene_used[m_scene] = true;
+        return true;
+}
+
+std::shared_ptr<const OrbitsPresetState> RareBreeds_Orbits_Polygene::decodePreset(json_t *data)
+{
+        std::shared_ptr<PolygenePresetState> preset = std::make_shared<PolygenePresetState>();
+        int scene = 0;
+        json_load_integer(data, "scene", &scene);
+
+        std::vector<uint8_t> packed;
+        uint16_t used;
+        json_t *obj = json_object_get(data, "channel_state");
+        if(!json_is_string(obj) || !decodeBase64(json_string_value(obj), json_string_length(obj), &packed) ||
+           !readPackedScenes(packed, &used, [&](int s, int channel, const PolygeneChannelState &state) {
+                   if(s == scene)
+                   {
+                           preset->m_channels.push_back(state);
+                   }
+           }))
+        {
+                // Settings missing from a channel are the defaults rather than what the channel had
+                size_t index;
+                json_t *channel;
+                json_array_foreach(json_object_get(data, "channels"), index, channel)
+                {
+                        if(index < max_channels)
+                        {
+                                PolygeneChannelState state = {rhythm::max_length, 0.5f, 0.f, 0.f, false, false,
+                                                              0.f, 0.f, -1, default_clock_ratio};
+                                channelStateFromJson(channel, &state);
+                                preset->m_channels.push_back(state);
+                        }
+                }
+        }
+
+        if(preset->m_channels.empty())
+        {
+                return NULL;
+        }
+        return preset;
+}
+
 json_t *RareBreeds_Orbits_Polygene::dataToJson()
 {
         json_t *root = json_object();
@@ -462,6 +1151,12 @@ json_t *RareBreeds_Orbits_Polygene::dataToJson()
         {
                 json_object_set_new(root, "beat", m_beat.dataToJson());
                 json_object_set_new(root, "eoc", m_eoc.dataToJson());
+                json_object_set_new(root, "swing", m_swing.dataToJson());
+                json_object_set_new(root, "accent", m_accent.dataToJson());
+                json_object_set_new(root, "bus", m_bus.dataToJson());
+                json_object_set_new(root, "precision", json_boolean(m_precision));
+                json_object_set_new(root, "internal_clock", json_boolean(m_internal_clock));
+                json_object_set_new(root, "internal_channels", json_integer(m_internal_channels));
 
                 json_object_set_new(root, "sync_cv", json_integer(m_input_mode[SYNC_INPUT]));
                 json_object_set_new(root, "length_cv", json_integer(m_input_mode[LENGTH_CV_INPUT]));
@@ -472,19 +1167,21 @@ json_t *RareBreeds_Orbits_Polygene::dataToJson()
                 json_object_set_new(root, "randomization_mask", json_integer(m_randomization_mask));
 
                 json_object_set_new(root, "active_channel_id", json_integer(m_active_channel_id));
+                json_object_set_new(root, "bank", json_integer(m_bank));
 
-                json_t *channels = json_array();
+                json_object_set_new(root, "scene", json_integer(m_scene));
+                json_object_set_new(root, "scene_on_eoc", json_boolean(m_scene_on_eoc));
+
+                // Only scenes that have been used are saved, packed into one string rather than
+                // an object per channel because 8FaceMk2 can load the state many times a second
+                json_object_set_new(root, "channel_state", json_string(packScenes().c_str()));
+
+                // The active scene's first bank is also saved as "channels", as many channels as older
+                // versions load. Newer versions only read it when "channel_state" is missing, the bank
+                // channels are only in "channel_state"
+                json_t *channels = sceneToJson(m_scenes[m_scene], PORT_MAX_CHANNELS);
                 if(channels)
                 {
-                        for(auto &chan : m_channels)
-                        {
-                                json_t *channel_json = chan.dataToJson();
-                                if(channel_json)
-                                {
-                                        json_array_append_new(channels, channel_json);
-                                }
-                        }
-
                         json_object_set_new(root, "channels", channels);
                 }
 
@@ -507,6 +1204,16 @@ void RareBreeds_Orbits_Polygene::dataFromJson(json_t *root)
         {
                 m_beat.dataFromJson(json_object_get(root, "beat"));
                 m_eoc.dataFromJson(json_object_get(root, "eoc"));
+                m_swing.dataFromJson(json_object_get(root, "swing"));
+                m_accent.dataFromJson(json_object_get(root, "accent"));
+                m_bus.dataFromJson(json_object_get(root, "bus"));
+                m_precision = false;
+                json_load_bool(root, "precision", &m_precision);
+                m_internal_clock = false;
+                json_load_bool(root, "internal_clock", &m_internal_clock);
+                m_internal_channels = 1;
+                json_load_integer(root, "internal_channels", &m_internal_channels);
+                m_internal_channels = math::clamp(m_internal_channels, 1, PORT_MAX_CHANNELS);
 
                 // v2.0.0 added "sync" to allow selection of the sync CV behavior when
                 // the cable is monophonic.
@@ -562,15 +1269,40 @@ void RareBreeds_Orbits_Polygene::dataFromJson(json_t *root)
                 json_load_integer(root, "randomization_mask", &m_randomization_mask);
 
                 json_load_integer(root, "active_channel_id", &m_active_channel_id);
-                json_t *channels = json_object_get(root, "channels");
-                if(channels)
+                m_bank = 0;
+                json_load_integer(root, "bank", &m_bank);
+                m_bank = math::clamp(m_bank, 0, max_banks - 1);
+                m_scene = 0;
+                json_load_integer(root, "scene", &m_scene);
+                m_scene = math::clamp(m_scene, 0, num_scenes - 1);
+                m_selected_scene = m_scene;
+                json_load_bool(root, "scene_on_eoc", &m_scene_on_eoc);
+                for(int i = 0; i < num_scenes; ++i)
                 {
-                        for(auto i = 0u; i < PORT_MAX_CHANNELS; ++i)
+                        m_scene_used[i] = i == m_scene;
+                }
+
+                // Older patches have the active scene in "channels" and the rest in "scenes"
+                obj = json_object_get(root, "channel_state");
+                if(!json_is_string(obj) || !unpackScenes(json_string_value(obj), json_string_length(obj)))
+                {
+                        sceneFromJson(json_object_get(root, "channels"), m_scenes[m_scene], max_channels);
+
+                        json_t *scenes = json_object_get(root, "scenes");
+                        if(scenes)
                         {
-                                json_t *channel = json_array_get(channels, i);
-                                if(channel)
+                                size_t index;
+                                json_t *scene;
+                                json_array_foreach(scenes, index, scene)
                                 {
-                                        m_channels[i].dataFromJson(channel);
+                                        int i = -1;
+                                        json_load_integer(scene, "scene", &i);
+                                        if(i >= 0 && i < num_scenes)
+                                        {
+                                                sceneFromJson(json_object_get(scene, "channels"), m_scenes[i],
+                                                              max_channels);
+                                                m_scene_used[i] = true;
+                                        }
                                 }
                         }
                 }
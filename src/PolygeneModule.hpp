@@ -1,11 +1,18 @@
 #pragma once
 
+#include "ExpanderModule.hpp"
+#include "OrbitsBus.hpp"
+#include "OrbitsCapture.hpp"
+#include "OrbitsExpanderMessage.hpp"
 #include "OrbitsModule.hpp"
+#include "OrbitsPresets.hpp"
+#include "OrbitsProfile.hpp"
 #include "Rhythm.hpp"
 
 #include <atomic>
 
 struct RareBreeds_Orbits_PolygeneWidget;
+struct RareBreeds_Orbits_PolygeneBank;
 
 enum InputMode
 {
@@ -21,17 +28,54 @@ enum InputMode
 
 struct PolygeneDisplayData
 {
-        unsigned int active_channel_id, active_channels;
+        // Channels of the bank being displayed, first_channel is the number of the first one
+        unsigned int active_channel_id, active_channels, first_channel;
         struct
         {
                 unsigned int length, hits, shift, variation, invert, current_step;
+                // The pattern drawn, which differs from the settings while morphing
+                uint32_t pattern;
         } channels[PORT_MAX_CHANNELS];
+
+        bool operator==(const PolygeneDisplayData &rhs) const
+        {
+                if(active_channel_id != rhs.active_channel_id || active_channels != rhs.active_channels ||
+                   first_channel != rhs.first_channel)
+                {
+                        return false;
+                }
+                for(unsigned int c = 0; c < PORT_MAX_CHANNELS; ++c)
+                {
+                        if(channels[c].length != rhs.channels[c].length || channels[c].hits != rhs.channels[c].hits ||
+                           channels[c].shift != rhs.channels[c].shift ||
+                           channels[c].variation != rhs.channels[c].variation ||
+                           channels[c].invert != rhs.channels[c].invert ||
+                           channels[c].current_step != rhs.channels[c].current_step ||
+                           channels[c].pattern != rhs.channels[c].pattern)
+                        {
+                                return false;
+                        }
+                }
+                return true;
+        }
+
+        bool operator!=(const PolygeneDisplayData &rhs) const
+        {
+                return !(*this == rhs);
+        }
 };
 
 struct PolygeneChannelState
 {
         float length, hits, shift, variation;
         bool reverse, invert;
+        float swing;
+        // Fraction of the length used as hits at the end of the morph
+        float morph;
+        // Channel whose pattern plays on each on beat, -1 for none
+        int inner;
+        // Index into clock_ratios used with the internal clock
+        int ratio;
 };
 
 struct RareBreeds_Orbits_Polygene : Module
@@ -47,6 +91,9 @@ struct RareBreeds_Orbits_Polygene : Module
                 INVERT_KNOB_PARAM,
                 RANDOM_KNOB_PARAM,
                 SYNC_KNOB_PARAM,
+                SWING_PARAM,
+                MORPH_PARAM,
+                TEMPO_PARAM,
                 NUM_PARAMS
         };
         enum InputIds
@@ -84,9 +131,19 @@ struct RareBreeds_Orbits_Polygene : Module
         };
         const unsigned int RANDOMIZE_ALL = (1 << RANDOMIZE_COUNT) - 1;
 
+        // Polygene has one bank of channels, each bank expander adds another
+        static const int max_banks = 4;
+        static const int max_channels = max_banks * PORT_MAX_CHANNELS;
+
         // The channel currently being displayed and controlled by the knobs
         int m_active_channel_id = 0;
-        int m_previous_channel_id = PORT_MAX_CHANNELS;
+        int m_previous_channel_id = max_channels;
+
+        // The bank selected for display and editing, and the number of banks attached
+        int m_bank = 0;
+        int m_banks = 1;
+        RareBreeds_Orbits_PolygeneBank *m_bank_modules[max_banks] = {};
+        int m_bank_channels[max_banks] = {};
 
         struct Channel
         {
@@ -99,14 +156,45 @@ struct RareBreeds_Orbits_Polygene : Module
                 dsp::SchmittTrigger m_random_trigger;
                 BeatGenerator m_beat_generator;
                 EOCGenerator m_eoc_generator;
-                PolygeneChannelState m_state;
+                SwingDelay m_swing_delay;
+                RatioClock m_ratio_clock;
+                PatternCache m_pattern;
+                MorphCache m_morph;
+                NestedPatternCache m_nested;
+                AnalysisCache m_analysis;
+                AccentTable m_accent_table;
+                float m_accent_level;
+                Lookahead m_lookahead;
+                OrbitsExpanderChannel m_published;
                 RareBreeds_Orbits_Polygene *m_module;
+#ifdef ORBITS_PROFILE
+                dsp::BooleanTrigger m_trace_beat;
+                dsp::BooleanTrigger m_trace_eoc;
+#endif
 
                 void init(RareBreeds_Orbits_Polygene *module, int channel);
+
+                // Channels on bank expanders share the clock and sync inputs but
+                // have no CV inputs of their own
+                bool isBankChannel(void) const
+                {
+                        return m_channel >= PORT_MAX_CHANNELS;
+                }
+
+                int getPortChannel(void) const
+                {
+                        return m_channel % PORT_MAX_CHANNELS;
+                }
+
+                // The state of this channel in the active scene
+                PolygeneChannelState &getState(void)
+                {
+                        return m_module->m_scenes[m_module->m_scene][m_channel];
+                }
                 bool readReverse(void);
                 bool readInvert(void);
-                static bool isOnBeat(unsigned int length, unsigned int hits, unsigned int shift, unsigned int variation,
-                                     unsigned int beat, bool invert);
+                // The invert setting as last read, without processing the CV trigger
+                bool isInverted(void);
                 unsigned int readLength();
                 unsigned int readStep(unsigned int length)
                 {
@@ -115,24 +203,74 @@ struct RareBreeds_Orbits_Polygene : Module
                 unsigned int readHits(unsigned int length);
                 unsigned int readShift(unsigned int length);
                 unsigned int readVariation(unsigned int length, unsigned int shift);
+                float readSwingOffset();
+                bool isMorphing();
+                float readMorph();
+                const PatternCache *readInner();
+                const PatternCache &readPattern();
                 void process(const ProcessArgs &args);
-                json_t *dataToJson();
-                void dataFromJson(json_t *root);
                 void onRandomizeWithHistory(int randomization_mask);
                 void onRandomize(int randomization_mask);
         };
 
+        // Scene memory holds the state of every channel for each scene,
+        // switching scene only changes which one the channels use
+        static const int num_scenes = 16;
+        PolygeneChannelState m_scenes[num_scenes][max_channels];
+        bool m_scene_used[num_scenes] = {};
+        int m_scene = 0;
+        // Chosen from the context menu, used when the scene CV isn't connected
+        int m_selected_scene = 0;
+        bool m_scene_on_eoc = false;
+        uint32_t m_scene_cycles = 0;
+        // Decoded channel state, kept so loading the state again doesn't allocate
+        std::vector<uint8_t> m_packed_scenes;
+
         int m_active_channels = 1;
-        Channel m_channels[PORT_MAX_CHANNELS];
+        Channel m_channels[max_channels];
+        float m_beat_voltages[max_channels] = {};
+        float m_eoc_voltages[max_channels] = {};
         Channel *m_active_channel;
         dsp::BooleanTrigger m_reverse_trigger;
         dsp::BooleanTrigger m_invert_trigger;
         RepeatTrigger m_random_trigger;
         dsp::BooleanTrigger m_sync_trigger;
         RareBreeds_Orbits_PolygeneWidget *m_widget = NULL;
+        OrbitsExpanderLink m_expander;
+#ifdef ORBITS_PROFILE
+        OrbitsProfile m_profile;
+        OrbitsTrace m_trace;
+        OrbitsCapture m_capture;
+        int m_trace_input_mode[NUM_INPUTS] = {};
+#endif
+        OrbitsExpanderPublisher m_publisher;
+        OrbitsPresetCV m_preset;
+        // What the display draws, published by the engine
+        DisplayWatch<PolygeneDisplayData> m_display;
+        OrbitsBusClient m_bus;
+        dsp::SchmittTrigger m_bus_clock_trigger;
+        bool m_bus_clock = false;
+        float m_bus_position = 0.f;
+
+        // Without a clock cable the internal clock drives this many channels
+        bool m_internal_clock = false;
+        int m_internal_channels = 1;
+        MasterClock m_master_clock;
+        dsp::SchmittTrigger m_external_clock_trigger;
+        RatioClock m_bus_ratio_clock;
+
+        // Band limited outputs with the steps placed where each clock channel crossed the threshold
+        bool m_precision = false;
+        float m_clock_voltages[PORT_MAX_CHANNELS] = {};
+        float m_clock_positions[PORT_MAX_CHANNELS] = {};
+        float m_edge_positions[max_channels] = {};
+        PrecisionOutputs<max_channels> m_precision_beat;
+        PrecisionOutputs<max_channels> m_precision_eoc;
         std::atomic<json_t *> m_widget_config{nullptr};
         BeatMode m_beat;
         EOCMode m_eoc;
+        SwingMode m_swing;
+        AccentMode m_accent;
         InputMode m_input_mode[NUM_INPUTS];
         int m_randomization_mask = RANDOMIZE_ALL;
 
@@ -140,12 +278,27 @@ struct RareBreeds_Orbits_Polygene : Module
         virtual ~RareBreeds_Orbits_Polygene();
         void reset();
         void syncParamsToActiveChannel();
+        void publish();
+        void findBanks();
+        int readScene();
+        void processScene();
+        void processPreset();
+        void copyScene(int from, int to);
+        void processBanks();
+        void findEdgePositions();
+        float readTempo();
+        std::string packScenes(void);
+        bool unpackScenes(const char *base64, size_t length);
+        static std::shared_ptr<const OrbitsPresetState> decodePreset(json_t *data);
         void process(const ProcessArgs &args) override;
+        void processBypass(const ProcessArgs &args) override;
         json_t *dataToJson() override;
         void dataFromJson(json_t *root) override;
         void onRandomize(const RandomizeEvent& e) override;
         void onReset(const ResetEvent& e) override;
+        // Engine thread, the data the display should draw
         PolygeneDisplayData getDisplayData(void);
+        // UI thread, the latest published data or the module browser's
         static PolygeneDisplayData getDisplayData(RareBreeds_Orbits_Polygene *module);
         float getParameterizedVoltage(int input_id, int channel);
         InputMode getInputMode(int input_id);
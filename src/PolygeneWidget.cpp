@@ -3,144 +3,259 @@
 #include "OrbitsSkinned.hpp"
 #include "PolygeneModule.hpp"
 
+#include <algorithm>
+#include <cmath>
+
 static OrbitsConfig g_config("res/polygene-layout.json");
 
-struct PolygeneRhythmDisplay : TransparentWidget, OrbitsSkinned
+// Hits and length of the active channel and its number, only drawn again when they change
+struct PolygeneRhythmText : Widget
 {
-        RareBreeds_Orbits_Polygene *module = NULL;
-        NVGcolor m_display_accent;
-
-        PolygeneRhythmDisplay();
-        void drawLayer(const DrawArgs &args, int layer) override;
-        void loadTheme(int theme) override;
+        unsigned int m_hits = 0;
+        unsigned int m_length = 0;
+        unsigned int m_channel = 0;
+        PolygeneRhythmText(Vec size);
+        void draw(const DrawArgs &args) override;
 };
 
-PolygeneRhythmDisplay::PolygeneRhythmDisplay()
+PolygeneRhythmText::PolygeneRhythmText(Vec size)
 {
-        loadTheme(g_config.getDefaultThemeId());
+        box.pos = Vec(0.0, 0.0);
+        box.size = size;
 }
 
-void PolygeneRhythmDisplay::loadTheme(int theme)
+void PolygeneRhythmText::draw(const DrawArgs &args)
 {
-        std::array<uint8_t, 3> colour = g_config.getColour("display_accent", theme);
-        m_display_accent = nvgRGB(colour[0], colour[1], colour[2]);
+        // Draw length text center bottom and hits text center top
+        nvgFillColor(args.vg, color::WHITE);
+        nvgTextAlign(args.vg, NVG_ALIGN_CENTER | NVG_ALIGN_MIDDLE);
+        nvgFontSize(args.vg, 18);
+        std::shared_ptr<Font> font = APP->window->loadFont(orbitsDisplayFont());
+        nvgFontFaceId(args.vg, font->handle);
+        nvgText(args.vg, box.size.x / 2.f, box.size.y / 2.f - 6.f, orbitsNumberText(m_hits), NULL);
+        nvgText(args.vg, box.size.x / 2.f, box.size.y / 2.f + 6.f, orbitsNumberText(m_length), NULL);
+
+        nvgFontSize(args.vg, 12);
+        nvgText(args.vg, 23.f, box.size.y - 9.f, orbitsNumberText(m_channel), NULL);
 }
 
-void PolygeneRhythmDisplay::drawLayer(const DrawArgs &args, int layer)
+// Gap between the arcs of neighbouring steps, in radians
+static const float g_beat_gap = 0.06f;
+
+// Where each step of a ring is drawn, for every length, as unit vectors scaled by the ring's radius
+struct PolygeneStep
 {
-        // Drawings to layer 1 don't dim when the room lights are dimmed
-        if(layer == 1)
+        // Start of the step's arc
+        float start_cos, start_sin;
+        // The current step marker, in the middle of the gap before the arc
+        float marker_cos, marker_sin;
+        // Angles of the arc
+        float a0, a1;
+};
+
+static const PolygeneStep *polygeneSteps(unsigned int length)
+{
+        static const struct Table
         {
-                PolygeneDisplayData data = RareBreeds_Orbits_Polygene::getDisplayData(module);
+                PolygeneStep steps[rhythm::max_length + 1][rhythm::max_length];
 
-                nvgGlobalTint(args.vg, color::WHITE);
-                const auto foreground_color = color::WHITE;
-                nvgStrokeColor(args.vg, foreground_color);
-                nvgSave(args.vg);
+                Table()
+                {
+                        for(unsigned int length = 1; length <= rhythm::max_length; ++length)
+                        {
+                                const float pi2_len = 2.0f * (float)M_PI / length;
+                                for(unsigned int k = 0; k < length; ++k)
+                                {
+                                        PolygeneStep &step = steps[length][k];
+                                        step.a0 = k * pi2_len + (float)M_PI_2;
+                                        step.a1 = step.a0 + pi2_len - g_beat_gap;
+                                        step.start_cos = std::cos(step.a0);
+                                        step.start_sin = std::sin(step.a0);
+                                        step.marker_cos = std::cos(step.a0 - g_beat_gap / 2.f);
+                                        step.marker_sin = std::sin(step.a0 - g_beat_gap / 2.f);
+                                }
+                        }
+                }
+        } table;
+        return table.steps[length];
+}
 
-                const Rect b = Rect(Vec(0, 0), box.size);
-                nvgScissor(args.vg, b.pos.x, b.pos.y, b.size.x, b.size.y);
+struct PolygeneRhythmRings : Widget
+{
+        PolygeneDisplayData m_data;
+        NVGcolor m_display_accent;
+        PolygeneRhythmRings(Vec size);
+        void draw(const DrawArgs &args) override;
+};
 
-                // Everything drawn after here is in the foreground colour
-                nvgStrokeColor(args.vg, foreground_color);
-                nvgFillColor(args.vg, foreground_color);
+PolygeneRhythmRings::PolygeneRhythmRings(Vec size)
+{
+        box.pos = Vec(0.0, 0.0);
+        box.size = size;
+}
 
-                // Translate so (0, 0) is the center of the screen
-                nvgTranslate(args.vg, b.size.x / 2.f, b.size.y / 2.f);
+void PolygeneRhythmRings::draw(const DrawArgs &args)
+{
+        const auto foreground_color = color::WHITE;
+        nvgSave(args.vg);
 
-                // Draw length text center bottom and hits text center top
-                nvgBeginPath(args.vg);
-                nvgTextAlign(args.vg, NVG_ALIGN_CENTER | NVG_ALIGN_MIDDLE);
-                nvgFontSize(args.vg, 18);
-                std::shared_ptr<Font> font = APP->window->loadFont(asset::plugin(pluginInstance, "res/fonts/ShareTechMono-Regular.ttf"));
-                nvgFontFaceId(args.vg, font->handle);
+        const Rect b = Rect(Vec(0, 0), box.size);
+        nvgScissor(args.vg, b.pos.x, b.pos.y, b.size.x, b.size.y);
 
-                const auto active_hits = data.channels[data.active_channel_id].hits;
-                nvgText(args.vg, 0.f, -6.f, std::to_string(active_hits).c_str(), NULL);
+        // Everything drawn after here is in the foreground colour
+        nvgStrokeColor(args.vg, foreground_color);
+        nvgFillColor(args.vg, foreground_color);
 
-                const auto active_length = data.channels[data.active_channel_id].length;
-                nvgText(args.vg, 0.f, 6.f, std::to_string(active_length).c_str(), NULL);
+        // Translate so (0, 0) is the center of the screen
+        nvgTranslate(args.vg, b.size.x / 2.f, b.size.y / 2.f);
 
-                const auto active_channel = data.active_channel_id + 1;
-                nvgFontSize(args.vg, 12);
-                nvgText(args.vg, -b.size.x / 2. + 23.f, b.size.y / 2. - 9.f, std::to_string(active_channel).c_str(), NULL);
+        // Scale to [-1, 1]
+        nvgScale(args.vg, b.size.x / 2.f, b.size.y / 2.f);
 
-                nvgFill(args.vg);
+        // Flip x and y so we start at the top and positive angle
+        // increments go clockwise
+        nvgScale(args.vg, -1.f, -1.f);
 
-                // Scale to [-1, 1]
-                nvgScale(args.vg, b.size.x / 2.f, b.size.y / 2.f);
+        // Inner circle radius
+        const float inner_circle_radius = 0.17f;
+        const float channel_width = (1.0f - inner_circle_radius) / 16.0f;
+        // Width of the line when drawing circles
+        const float arc_stroke_width = channel_width / 2.0f;
 
-                // Flip x and y so we start at the top and positive angle
-                // increments go clockwise
-                nvgScale(args.vg, -1.f, -1.f);
+        // Add a border so we don't draw over the edge
+        nvgScale(args.vg, 1.0f - channel_width, 1.0f - channel_width);
 
-                // Inner circle radius
-                const float inner_circle_radius = 0.17f;
-                const float channel_width = (1.0f - inner_circle_radius) / 16.0f;
-                // Width of the line when drawing circles
-                const float arc_stroke_width = channel_width / 2.0f;
+        nvgStrokeWidth(args.vg, arc_stroke_width);
+        for(unsigned int c = 0; c < PORT_MAX_CHANNELS; ++c)
+        {
+                const unsigned int length = std::min(m_data.channels[c].length, rhythm::max_length);
+                const float radius = 1.0f - c * channel_width;
+                const PolygeneStep *steps = polygeneSteps(length);
 
-                // Add a border so we don't draw over the edge
-                nvgScale(args.vg, 1.0f - channel_width, 1.0f - channel_width);
+                NVGcolor dash_colour;
+                if(c == m_data.active_channel_id)
+                {
+                        dash_colour = m_display_accent;
+                }
+                else if(c < m_data.active_channels)
+                {
+                        dash_colour = nvgRGB(0xff, 0xff, 0xff);
+                }
+                else
+                {
+                        dash_colour = nvgRGB(0x50, 0x50, 0x50);
+                }
 
-                nvgStrokeWidth(args.vg, arc_stroke_width);
-                for(unsigned int c = 0; c < PORT_MAX_CHANNELS; ++c)
+                nvgStrokeColor(args.vg, dash_colour);
+                nvgFillColor(args.vg, dash_colour);
+                // The engine is run in a different thread, m_current_step is only updated on each clock
+                // cycle so may not have been wrapped to a new length parameter yet. If the current step
+                // is out of bounds then display it at 0.
+                unsigned int current_step = m_data.channels[c].current_step;
+                if(current_step < length)
                 {
-                        const unsigned int length = data.channels[c].length;
-                        const float radius = 1.0f - c * channel_width;
-                        const float pi2_len = 2.0f * (float)M_PI / length;
-                        const float beat_gap = 0.06f;
-                        const float len = pi2_len - beat_gap;
-
-                        NVGcolor dash_colour;
-                        if(c == data.active_channel_id)
-                        {
-                                dash_colour = m_display_accent;
-                        }
-                        else if(c < data.active_channels)
-                        {
-                                dash_colour = nvgRGB(0xff, 0xff, 0xff);
-                        }
-                        else
+                        nvgBeginPath(args.vg);
+                        nvgCircle(args.vg,
+                                  radius * steps[current_step].marker_cos,
+                                  radius * steps[current_step].marker_sin,
+                                  arc_stroke_width / 2.0f);
+                        nvgFill(args.vg);
+                }
+
+                // Every on beat of the ring in one path, moving to each arc so they aren't joined
+                nvgBeginPath(args.vg);
+                for(unsigned int k = 0; k < length; ++k)
+                {
+                        if((m_data.channels[c].pattern >> k) & 1)
                         {
-                                dash_colour = nvgRGB(0x50, 0x50, 0x50);
+                                nvgMoveTo(args.vg, radius * steps[k].start_cos, radius * steps[k].start_sin);
+                                nvgArc(args.vg, 0.0f, 0.0f, radius, steps[k].a0, steps[k].a1, NVG_CW);
                         }
+                }
+                nvgStroke(args.vg);
+        }
 
-                        nvgStrokeColor(args.vg, dash_colour);
-                        nvgFillColor(args.vg, dash_colour);
-                        // The engine is run in a different thread, m_current_step is only updated on each clock
-                        // cycle so may not have been wrapped to a new length parameter yet. If the current step
-                        // is out of bounds then display it at 0.
-                        unsigned int current_step = data.channels[c].current_step;
-                        for(unsigned int k = 0; k < length; ++k)
-                        {
-                                const float a0 = k * pi2_len + (float)M_PI_2;
-                                const float a1 = a0 + len;
+        nvgResetScissor(args.vg);
+        nvgRestore(args.vg);
+}
 
-                                if(current_step == k)
-                                {
-                                        const auto center = a0 - beat_gap / 2.f;
-                                        nvgBeginPath(args.vg);
-                                        nvgCircle(args.vg,
-                                                  radius * cosf(center),
-                                                  radius * sinf(center),
-                                                  arc_stroke_width / 2.0f);
-                                        nvgFill(args.vg);
-                                }
+// The rings and the text are cached separately, most changes only move the current steps
+struct PolygeneRhythmDisplay : TransparentWidget, OrbitsSkinned
+{
+        RareBreeds_Orbits_Polygene *m_module;
+        OrbitsDisplayRefresh m_refresh;
+        OrbitsDisplayBuffer *m_fb;
+        PolygeneRhythmRings *m_rings;
+        OrbitsDisplayBuffer *m_text_fb;
+        PolygeneRhythmText *m_text;
+
+        PolygeneRhythmDisplay(RareBreeds_Orbits_Polygene *module, const OrbitsDisplayRate *rate, Vec pos, Vec size);
+        void drawLayer(const DrawArgs &args, int layer) override;
+        void loadTheme(int theme) override;
+        // Reads the module and marks the parts of the display that changed
+        void readModule(void);
+};
 
-                                auto on_beat = RareBreeds_Orbits_Polygene::Channel::isOnBeat(length, data.channels[c].hits, data.channels[c].shift,
-                                                                                   data.channels[c].variation, k, data.channels[c].invert);
-                                if(on_beat)
-                                {
-                                        nvgBeginPath(args.vg);
-                                        nvgArc(args.vg, 0.0f, 0.0f, radius, a0, a1, NVG_CW);
-                                        nvgStroke(args.vg);
-                                }
-                        }
-                }
+PolygeneRhythmDisplay::PolygeneRhythmDisplay(RareBreeds_Orbits_Polygene *module, const OrbitsDisplayRate *rate,
+                                             Vec pos, Vec size)
+{
+        m_module = module;
+        m_refresh.m_rate = rate;
+        box.pos = pos;
+        box.size = size;
+        m_fb = new OrbitsDisplayBuffer(size);
+        addChild(m_fb);
+        m_rings = new PolygeneRhythmRings(size);
+        m_fb->addChild(m_rings);
+        m_text_fb = new OrbitsDisplayBuffer(size);
+        addChild(m_text_fb);
+        m_text = new PolygeneRhythmText(size);
+        m_text_fb->addChild(m_text);
+        loadTheme(g_config.getDefaultThemeId());
+}
 
-                nvgResetScissor(args.vg);
-                nvgRestore(args.vg);
+void PolygeneRhythmDisplay::loadTheme(int theme)
+{
+        std::array<uint8_t, 3> colour = g_config.getColour("display_accent", theme);
+        m_rings->m_display_accent = nvgRGB(colour[0], colour[1], colour[2]);
+        m_fb->dirty = true;
+}
+
+void PolygeneRhythmDisplay::readModule(void)
+{
+        PolygeneDisplayData data = RareBreeds_Orbits_Polygene::getDisplayData(m_module);
+        if(data != m_rings->m_data)
+        {
+                m_rings->m_data = data;
+                m_fb->dirty = true;
+        }
+
+        const auto active_hits = data.channels[data.active_channel_id].hits;
+        const auto active_length = data.channels[data.active_channel_id].length;
+        const auto active_channel = data.first_channel + data.active_channel_id;
+        if(active_hits != m_text->m_hits || active_length != m_text->m_length ||
+           active_channel != m_text->m_channel)
+        {
+                m_text->m_hits = active_hits;
+                m_text->m_length = active_length;
+                m_text->m_channel = active_channel;
+                m_text_fb->dirty = true;
+        }
+}
+
+void PolygeneRhythmDisplay::drawLayer(const DrawArgs &args, int layer)
+{
+        // Drawings to layer 1 don't dim when the room lights are dimmed
+        if(layer == 1)
+        {
+                nvgGlobalTint(args.vg, color::WHITE);
+
+                // The module browser's display never changes
+                uint32_t generation = m_module ? m_module->m_display.getGeneration() : 1;
+                if(m_refresh.update(generation))
+                {
+                        readModule();
+                }
         }
 
         Widget::drawLayer(args, layer);
@@ -157,6 +272,26 @@ RareBreeds_Orbits_PolygeneWidget::RareBreeds_Orbits_PolygeneWidget(RareBreeds_Or
                 module->m_widget = this;
                 beat_widget.m_module = &module->m_beat;
                 eoc_widget.m_module = &module->m_eoc;
+                swing_widget.m_module = &module->m_swing;
+                swing_widget.m_quantity = module->getParamQuantity(RareBreeds_Orbits_Polygene::SWING_PARAM);
+                morph_widget.m_quantity = module->getParamQuantity(RareBreeds_Orbits_Polygene::MORPH_PARAM);
+                clock_widget.m_enabled = &module->m_internal_clock;
+                clock_widget.m_tempo = module->getParamQuantity(RareBreeds_Orbits_Polygene::TEMPO_PARAM);
+                clock_widget.m_channels = &module->m_internal_channels;
+                accent_widget.m_module = &module->m_accent;
+                bus_widget.m_module = &module->m_bus;
+                preset_widget.m_module = module;
+                preset_widget.m_cv = &module->m_preset;
+                preset_widget.m_decode = RareBreeds_Orbits_Polygene::decodePreset;
+                preset_widget.refresh();
+#ifdef ORBITS_PROFILE
+                diagnostics_widget.m_profile = &module->m_profile;
+                diagnostics_widget.m_trace = &module->m_trace;
+                diagnostics_widget.m_capture = [](Module *module) {
+                        return &static_cast<RareBreeds_Orbits_Polygene *>(module)->m_capture;
+                };
+                diagnostics_widget.m_module = module;
+#endif
         }
 
         m_theme = m_config->getDefaultThemeId();
@@ -194,10 +329,8 @@ RareBreeds_Orbits_PolygeneWidget::RareBreeds_Orbits_PolygeneWidget(RareBreeds_Or
         addOutput(createOrbitsSkinnedOutput(m_config, "eoc_port", module, RareBreeds_Orbits_Polygene::EOC_OUTPUT));
         // clang-format on
 
-        PolygeneRhythmDisplay *r = createWidget<PolygeneRhythmDisplay>(m_config->getPos("display"));
-        r->module = module;
-        r->box.size = m_config->getSize("display");
-        addChild(r);
+        addChild(new PolygeneRhythmDisplay(module, &m_display_rate, m_config->getPos("display"),
+                                           m_config->getSize("display")));
 }
 
 static void ToggleInputMode(InputMode *mode)
@@ -218,8 +351,95 @@ void RareBreeds_Orbits_PolygeneWidget::appendModuleContextMenu(Menu *menu)
 {
         beat_widget.appendContextMenu(menu);
         eoc_widget.appendContextMenu(menu);
+        swing_widget.appendContextMenu(menu);
+        morph_widget.appendContextMenu(menu);
+        accent_widget.appendContextMenu(menu);
+        clock_widget.appendContextMenu(menu);
+        bus_widget.appendContextMenu(menu);
+        preset_widget.appendContextMenu(menu);
+#ifdef ORBITS_PROFILE
+        diagnostics_widget.appendContextMenu(menu);
+#endif
 
         RareBreeds_Orbits_Polygene *polygene = static_cast<RareBreeds_Orbits_Polygene *>(module);
+        menu->addChild(createBoolPtrMenuItem("Precision outputs", "", &polygene->m_precision));
+
+        menu->addChild(createSubmenuItem("Bank", "",
+                [=](Menu* menu) {
+                        menu->addChild(createMenuLabel("Channels shown and edited, add banks with Polygene Bank"));
+
+                        for(int b = 0; b < polygene->m_banks; ++b)
+                        {
+                                int first = b * PORT_MAX_CHANNELS + 1;
+                                std::string label = string::f("%d-%d", first, first + PORT_MAX_CHANNELS - 1);
+                                menu->addChild(createCheckMenuItem(label, "",
+                                        [=]() {return std::min(polygene->m_bank, polygene->m_banks - 1) == b;},
+                                        [=]() {polygene->m_bank = b;}
+                                ));
+                        }
+                }
+        ));
+
+        menu->addChild(createSubmenuItem("Nest", "",
+                [=](Menu* menu) {
+                        menu->addChild(createMenuLabel("Play another channel's pattern on each on-beat"));
+                        int channel = polygene->m_active_channel_id;
+                        int *inner = &polygene->m_channels[channel].getState().inner;
+                        menu->addChild(createCheckMenuItem("None", "",
+                                [=]() {return *inner < 0;},
+                                [=]() {*inner = -1;}
+                        ));
+                        for(int i = 0; i < polygene->m_banks * PORT_MAX_CHANNELS; ++i)
+                        {
+                                menu->addChild(createCheckMenuItem(string::f("Channel %d", i + 1), "",
+                                        [=]() {return *inner == i;},
+                                        [=]() {*inner = i;},
+                                        i == channel
+                                ));
+                        }
+                }
+        ));
+
+        menu->addChild(createSubmenuItem("Clock Ratio", "",
+                [=](Menu* menu) {
+                        menu->addChild(createMenuLabel("Beats of the internal clock played by this channel"));
+                        int *ratio = &polygene->m_channels[polygene->m_active_channel_id].getState().ratio;
+                        for(int i = 0; i < num_clock_ratios; ++i)
+                        {
+                                menu->addChild(createCheckMenuItem(clock_ratios[i].name, "",
+                                        [=]() {return *ratio == i;},
+                                        [=]() {*ratio = i;}
+                                ));
+                        }
+                }
+        ));
+
+        menu->addChild(createSubmenuItem("Scene", "",
+                [=](Menu* menu) {
+                        menu->addChild(createMenuLabel("Selected by the expander scene CV when connected"));
+                        for(int i = 0; i < RareBreeds_Orbits_Polygene::num_scenes; ++i)
+                        {
+                                menu->addChild(createCheckMenuItem(string::f("Scene %d", i + 1), "",
+                                        [=]() {return polygene->m_scene == i;},
+                                        [=]() {polygene->m_selected_scene = i;}
+                                ));
+                        }
+
+                        menu->addChild(new MenuSeparator);
+                        menu->addChild(createBoolPtrMenuItem("Switch at end of cycle", "", &polygene->m_scene_on_eoc));
+                        menu->addChild(createSubmenuItem("Copy scene to", "",
+                                [=](Menu* menu) {
+                                        for(int i = 0; i < RareBreeds_Orbits_Polygene::num_scenes; ++i)
+                                        {
+                                                menu->addChild(createMenuItem(string::f("Scene %d", i + 1), "",
+                                                        [=]() {polygene->copyScene(polygene->m_scene, i);},
+                                                        i == polygene->m_scene
+                                                ));
+                                        }
+                                }
+                        ));
+                }
+        ));
 
         menu->addChild(createSubmenuItem("Randomize Filter", "",
                 [=](Menu* menu) {
@@ -8,6 +8,15 @@ struct RareBreeds_Orbits_PolygeneWidget : OrbitsWidget
 {
         BeatWidget beat_widget;
         EOCWidget eoc_widget;
+        SwingWidget swing_widget;
+        MorphWidget morph_widget;
+        ClockWidget clock_widget;
+#ifdef ORBITS_PROFILE
+        DiagnosticsWidget diagnostics_widget;
+#endif
+        AccentWidget accent_widget;
+        BusWidget bus_widget;
+        PresetWidget preset_widget;
         RareBreeds_Orbits_PolygeneWidget(RareBreeds_Orbits_Polygene *module);
         void appendModuleContextMenu(Menu *menu) override;
         void draw(const DrawArgs& args) override;
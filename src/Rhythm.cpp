@@ -1,4 +1,11 @@
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RHYTHM_X86
+#endif
 
 #include "Rhythm.hpp"
 #include "rhythm_table.h"
@@ -10,6 +17,21 @@ static uint32_t sumTo(uint32_t n)
         return n * (n + 1) / 2;
 }
 
+static uint32_t mask(uint32_t length)
+{
+        return length >= max_length ? UINT32_MAX : (1u << length) - 1;
+}
+
+static uint32_t rotateRight(uint32_t pattern, uint32_t size, uint32_t amount)
+{
+        amount %= size;
+        if(amount == 0)
+        {
+                return pattern;
+        }
+        return ((pattern >> amount) | (pattern << (size - amount))) & mask(size);
+}
+
 Rhythm rhythm(uint32_t length, uint32_t on_beats)
 {
         return nearEvenRhythm(length, on_beats, 0);
@@ -47,4 +69,343 @@ bool nearEvenRhythmBeat(uint32_t length, uint32_t on_beats, uint32_t variation,
         return rotate(nearEvenRhythm(length, on_beats, variation), length, shift)[num];
 }
 
+uint32_t word(Rhythm val, uint32_t length)
+{
+        return (uint32_t)val.to_ulong() & mask(length);
+}
+
+uint32_t nearEvenWord(uint32_t length, uint32_t density)
+{
+        return neareven_rhythms[neareven_offsets[sumTo(length) - 1 + density]];
+}
+
+uint32_t stepsToNextBeat(uint32_t pattern, uint32_t length, uint32_t num, bool reverse)
+{
+        pattern &= mask(length);
+        if(pattern == 0)
+        {
+                return 0;
+        }
+
+        if(reverse)
+        {
+                // Step num moves to bit 0 so num - 1 is the top bit, the highest
+                // on beat is the nearest one going backwards
+                uint32_t rotated = rotateRight(pattern, length, num);
+                uint32_t highest = 31 - __builtin_clz(rotated);
+                return length - highest;
+        }
+        else
+        {
+                // Step num + 1 moves to bit 0, the lowest on beat is the nearest one
+                uint32_t rotated = rotateRight(pattern, length, num + 1);
+                return __builtin_ctz(rotated) + 1;
+        }
+}
+
+uint32_t maxOuterLength(uint32_t inner_length)
+{
+        return std::max(1u, max_length / std::max(1u, inner_length));
+}
+
+uint32_t nest(uint32_t outer, uint32_t outer_length, uint32_t inner, uint32_t inner_length, uint32_t *length)
+{
+        outer_length = std::min(outer_length, maxOuterLength(inner_length));
+        *length = outer_length * inner_length;
+        inner &= mask(inner_length);
+
+        uint32_t result = 0;
+        for(uint32_t o = outer & mask(outer_length); o; o &= o - 1)
+        {
+                result |= inner << (__builtin_ctz(o) * inner_length);
+        }
+        return result;
+}
+
+uint32_t rotateWord(uint32_t pattern, uint32_t length, uint32_t amount)
+{
+        return rotateRight(pattern & mask(length), length, length - amount % length);
+}
+
+static uint32_t circularDistance(uint32_t a, uint32_t b, uint32_t length)
+{
+        uint32_t d = a > b ? a - b : b - a;
+        return std::min(d, length - d);
+}
+
+uint32_t morphPath(uint32_t length, uint32_t from, uint32_t to, uint32_t *path)
+{
+        from &= mask(length);
+        to &= mask(length);
+        uint32_t removals = from & ~to;
+        uint32_t additions = to & ~from;
+
+        // Pair each removed on beat with the nearest added one, this moves an
+        // on beat along the ring like distance() in scripts/rhythm.py
+        struct Move
+        {
+                uint32_t removal, addition, distance;
+        } moves[max_length / 2];
+        uint32_t num_moves = 0;
+        while(removals && additions)
+        {
+                Move best = {0, 0, UINT32_MAX};
+                for(uint32_t r = removals; r; r &= r - 1)
+                {
+                        for(uint32_t a = additions; a; a &= a - 1)
+                        {
+                                uint32_t d = circularDistance(__builtin_ctz(r), __builtin_ctz(a), length);
+                                if(d < best.distance)
+                                {
+                                        best = {r & -r, a & -a, d};
+                                }
+                        }
+                }
+                removals &= ~best.removal;
+                additions &= ~best.addition;
+                moves[num_moves++] = best;
+        }
+
+        // Shortest moves first, like the best paths found by findBestPath()
+        std::stable_sort(moves, moves + num_moves,
+                         [](const Move &a, const Move &b) { return a.distance < b.distance; });
+
+        // Whatever is left changes the number of on beats, spread it evenly between the moves
+        uint32_t leftover = removals | additions;
+        uint32_t num_leftover = __builtin_popcount(leftover);
+        uint32_t total = num_moves + num_leftover;
+
+        uint32_t size = 0;
+        uint32_t pattern = from;
+        path[size++] = pattern;
+        for(uint32_t i = 0, m = 0; i < total; ++i)
+        {
+                if((i + 1) * num_leftover / total > i * num_leftover / total)
+                {
+                        pattern ^= leftover & -leftover;
+                        leftover &= leftover - 1;
+                        path[size++] = pattern;
+                }
+                else
+                {
+                        // Add before removing so the pattern never thins out mid move
+                        pattern ^= moves[m].addition;
+                        path[size++] = pattern;
+                        pattern ^= moves[m].removal;
+                        path[size++] = pattern;
+                        ++m;
+                }
+        }
+
+        return size;
+}
+
+// Each entry of the search is a key of (distance << 8 | shift), so the
+// smallest key is the nearest rhythm and ties go to the smallest shift
+static void nearestKeysScalar(const uint32_t *rhythms, uint32_t count, uint32_t pattern, uint32_t shift,
+                              uint32_t *keys)
+{
+        for(uint32_t i = 0; i < count; ++i)
+        {
+                keys[i] = std::min(keys[i], (uint32_t)__builtin_popcount(rhythms[i] ^ pattern) << 8 | shift);
+        }
+}
+
+#ifdef RHYTHM_X86
+// AVX2 has no popcount instruction, count the bits of each nibble with a
+// lookup table then add up the bytes of each 32 bit lane
+__attribute__((target("avx2"))) static void nearestKeysAVX2(const uint32_t *rhythms, uint32_t count,
+                                                             uint32_t pattern, uint32_t shift, uint32_t *keys)
+{
+        const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                                0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+        const __m256i nibble = _mm256_set1_epi8(0x0f);
+        const __m256i ones8 = _mm256_set1_epi8(1);
+        const __m256i ones16 = _mm256_set1_epi16(1);
+        const __m256i p = _mm256_set1_epi32(pattern);
+        const __m256i s = _mm256_set1_epi32(shift);
+
+        uint32_t i = 0;
+        for(; i + 8 <= count; i += 8)
+        {
+                __m256i x = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(rhythms + i)), p);
+                __m256i lo = _mm256_shuffle_epi8(lookup, _mm256_and_si256(x, nibble));
+                __m256i hi = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(x, 4), nibble));
+                __m256i bytes = _mm256_add_epi8(lo, hi);
+                __m256i bits = _mm256_madd_epi16(_mm256_maddubs_epi16(bytes, ones8), ones16);
+                __m256i key = _mm256_or_si256(_mm256_slli_epi32(bits, 8), s);
+                __m256i *dst = (__m256i *)(keys + i);
+                _mm256_storeu_si256(dst, _mm256_min_epu32(_mm256_loadu_si256(dst), key));
+        }
+
+        nearestKeysScalar(rhythms + i, count - i, pattern, shift, keys + i);
+}
+#endif
+
+// Only ever cleared by scripts/bench_rhythm.cpp to compare the kernels
+static bool vector_search = true;
+
+void useVectorSearch(bool enable)
+{
+        vector_search = enable;
+}
+
+static void nearestKeys(const uint32_t *rhythms, uint32_t count, uint32_t pattern, uint32_t shift, uint32_t *keys)
+{
+#ifdef RHYTHM_X86
+        static const bool avx2 = __builtin_cpu_supports("avx2");
+        if(avx2 && vector_search)
+        {
+                nearestKeysAVX2(rhythms, count, pattern, shift, keys);
+                return;
+        }
+#endif
+        nearestKeysScalar(rhythms, count, pattern, shift, keys);
+}
+
+static uint32_t gcd(uint32_t a, uint32_t b)
+{
+        while(b)
+        {
+                uint32_t t = a % b;
+                a = b;
+                b = t;
+        }
+        return a;
+}
+
+// Off beats are the generators of the cyclic group of order length
+static uint32_t offBeats(uint32_t length)
+{
+        uint32_t result = 0;
+        for(uint32_t i = 0; i < length; ++i)
+        {
+                if(gcd(length, i) == 1)
+                {
+                        result |= 1u << i;
+                }
+        }
+        return result;
+}
+
+Analysis analyse(uint32_t length, uint32_t pattern)
+{
+        pattern &= mask(length);
+
+        Analysis result = {};
+        result.evenness = 0.f;
+
+        // Onsets d steps apart are the bits still set after and'ing with the pattern shifted by d,
+        // distances further than half way are counted the short way around
+        for(uint32_t d = 1; d < length; ++d)
+        {
+                uint32_t pairs = __builtin_popcount(pattern & (pattern >> d));
+                uint32_t interval = std::min(d, length - d);
+                result.inter_onset[interval - 1] += pairs;
+        }
+
+        for(uint32_t k = 1; k <= length / 2; ++k)
+        {
+                result.evenness += 2.f * std::sin(k * (float)M_PI / length) * result.inter_onset[k - 1];
+        }
+
+        uint32_t onsets = __builtin_popcount(pattern);
+        result.off_beatness = onsets ? (float)__builtin_popcount(pattern & offBeats(length)) / onsets : 0.f;
+
+        // Odd length rhythms never have an onset opposite another
+        uint32_t half = length / 2;
+        result.odd = (length % 2) || !(pattern & (pattern >> half) & mask(half));
+
+        return result;
+}
+
+// Shared by every module, the first variation is the most even. Built when the
+// plugin is loaded rather than on first use, which would be on the audio thread.
+struct MaxEvennessTable
+{
+        float evenness[max_length + 1][max_length + 1];
+
+        MaxEvennessTable()
+        {
+                for(uint32_t l = 1; l <= max_length; ++l)
+                {
+                        for(uint32_t o = 0; o <= l; ++o)
+                        {
+                                evenness[l][o] = analyse(l, word(nearEvenRhythm(l, o, 0), l)).evenness;
+                        }
+                }
+        }
+};
+
+static const MaxEvennessTable max_evenness;
+
+float maxEvenness(uint32_t length, uint32_t onsets)
+{
+        return max_evenness.evenness[length][onsets];
+}
+
+uint32_t findNearest(uint32_t length, uint32_t pattern, bool rotate, Match *matches, uint32_t k)
+{
+        // Every density of a length is stored together in the table
+        uint32_t off = sumTo(length) - 1;
+        uint32_t first = neareven_offsets[off];
+        uint32_t count = neareven_offsets[off + length] + neareven_count[off + length] - first;
+        const uint32_t *rhythms = &neareven_rhythms[first];
+
+        // 900 rhythms of length 32 is the most
+        uint32_t keys[1024];
+        assert(count <= sizeof(keys) / sizeof(keys[0]));
+        std::fill(keys, keys + count, UINT32_MAX);
+
+        // Rotating the pattern right by shift is the same as rotating the rhythm left by shift
+        pattern &= mask(length);
+        for(uint32_t shift = 0; shift < (rotate ? length : 1); ++shift)
+        {
+                nearestKeys(rhythms, count, rotateRight(pattern, length, shift), shift, keys);
+        }
+
+        // Keep the k smallest keys in order
+        uint32_t best[32];
+        uint32_t index[32];
+        k = std::min<uint32_t>({k, count, 32});
+        if(k == 0)
+        {
+                return 0;
+        }
+
+        uint32_t found = 0;
+        for(uint32_t i = 0; i < count; ++i)
+        {
+                if(found == k && keys[i] >= best[k - 1])
+                {
+                        continue;
+                }
+
+                uint32_t j = found < k ? found++ : k - 1;
+                for(; j > 0 && best[j - 1] > keys[i]; --j)
+                {
+                        best[j] = best[j - 1];
+                        index[j] = index[j - 1];
+                }
+                best[j] = keys[i];
+                index[j] = i;
+        }
+
+        for(uint32_t i = 0; i < found; ++i)
+        {
+                uint32_t density = 0;
+                while(first + index[i] >= neareven_offsets[off + density] + neareven_count[off + density])
+                {
+                        ++density;
+                }
+
+                matches[i].density = density;
+                matches[i].variation = first + index[i] - neareven_offsets[off + density];
+                matches[i].shift = best[i] & 0xff;
+                matches[i].distance = best[i] >> 8;
+        }
+
+        return found;
+}
+
 } // namespace rhythm
@@ -18,4 +18,68 @@ uint32_t numNearEvenRhythms(uint32_t length, uint32_t density);
 Rhythm nearEvenRhythm(uint32_t length, uint32_t density, uint32_t variation);
 bool nearEvenRhythmBeat(uint32_t length, uint32_t on_beats, uint32_t variation, uint32_t shift, uint32_t num);
 
+// The rhythm as a word with one bit per step, bits at and above length are clear
+uint32_t word(Rhythm val, uint32_t length);
+
+// The first near even rhythm as a word, straight from the table
+uint32_t nearEvenWord(uint32_t length, uint32_t density);
+
+// Number of steps after num until the next on beat in the direction of play.
+// Between 1 and length, or 0 if there are no on beats.
+uint32_t stepsToNextBeat(uint32_t pattern, uint32_t length, uint32_t num, bool reverse);
+
+// The longest outer pattern that inner_length steps can be nested in without
+// going over max_length steps, at least 1.
+uint32_t maxOuterLength(uint32_t inner_length);
+
+// Replaces each on beat of outer with the inner pattern and each off beat with
+// a rest as long as inner. Sets length to the nested length, outer_length is
+// limited to maxOuterLength(inner_length) so every outer step fits.
+uint32_t nest(uint32_t outer, uint32_t outer_length, uint32_t inner, uint32_t inner_length, uint32_t *length);
+
+// Rotates a pattern word the same way as rotate()
+uint32_t rotateWord(uint32_t pattern, uint32_t length, uint32_t amount);
+
+// Shortest path from one pattern word to another changing one step at a time.
+// Fills path with from, each intermediate pattern, then to, and returns the
+// number of patterns, at most max_length + 1.
+uint32_t morphPath(uint32_t length, uint32_t from, uint32_t to, uint32_t *path);
+
+// A near even rhythm found by findNearest()
+struct Match
+{
+        uint32_t density, variation;
+        // Rotation of the near even rhythm that matched, always 0 unless rotations were searched
+        uint32_t shift;
+        // Number of steps that differ
+        uint32_t distance;
+};
+
+// Finds the k near even rhythms of length that are closest to pattern, nearest
+// first. With rotate every shift of each rhythm is tried and the closest used.
+// Returns the number of matches, at most k.
+uint32_t findNearest(uint32_t length, uint32_t pattern, bool rotate, Match *matches, uint32_t k);
+
+// Lets findNearest() use the AVX2 search where the CPU has it (the default),
+// or always the scalar one so the two can be checked against each other
+void useVectorSearch(bool enable);
+
+// Measures of a rhythm's character, ported from scripts/rhythm.py
+struct Analysis
+{
+        // Number of onset pairs at each distance around the circle, from 1 to length / 2
+        uint8_t inter_onset[max_length / 2];
+        // Inter-onset vector weighted by chord length, highest for the most even rhythms
+        float evenness;
+        // Fraction of the onsets on steps relatively prime to the length, varies with rotation
+        float off_beatness;
+        // No two onsets are opposite each other on the circle
+        bool odd;
+};
+
+Analysis analyse(uint32_t length, uint32_t pattern);
+
+// Evenness of the most even rhythm with this many onsets, used to scale evenness to [0, 1]
+float maxEvenness(uint32_t length, uint32_t onsets);
+
 }
@@ -9,6 +9,8 @@ void init(Plugin *p)
         // Add modules here
         p->addModel(modelRareBreeds_Orbits_Eugene);
         p->addModel(modelRareBreeds_Orbits_Polygene);
+        p->addModel(modelRareBreeds_Orbits_Expander);
+        p->addModel(modelRareBreeds_Orbits_PolygeneBank);
 
         // Any other plugin initialization may go here.
         // As an alternative, consider lazy-loading assets and lookup tables when your module is created to reduce